@@ -0,0 +1,39 @@
+#include <algorithm>
+
+#include "backoff.hpp"
+
+namespace gcu {
+
+    constexpr std::size_t BackoffPolicy::unlimited;
+
+    Backoff::Backoff( BackoffPolicy const& policy )
+            : policy_( policy )
+            , random_( std::random_device()() )
+    {
+    }
+
+    bool Backoff::exhausted() const
+    {
+        return policy_.maxRetries != BackoffPolicy::unlimited && attempts_ >= policy_.maxRetries;
+    }
+
+    std::chrono::milliseconds Backoff::next()
+    {
+        auto maxDelay = (double) policy_.maxDelay.count();
+        delay_ = attempts_++ == 0
+                 ? (double) policy_.initialDelay.count()
+                 : std::min( delay_ * policy_.multiplier, maxDelay );
+
+        // jittered before the cap, so maxDelay bounds the actual wait
+        std::uniform_real_distribution< double > jitter( 1.0 - policy_.jitter, 1.0 + policy_.jitter );
+        return std::chrono::milliseconds(
+                (std::chrono::milliseconds::rep) std::min( delay_ * jitter( random_ ), maxDelay ) );
+    }
+
+    void Backoff::reset()
+    {
+        attempts_ = 0;
+        delay_ = 0.0;
+    }
+
+} // namespace gcu
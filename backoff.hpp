@@ -0,0 +1,45 @@
+#ifndef GCODEUPLOADER_BACKOFF_HPP
+#define GCODEUPLOADER_BACKOFF_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <random>
+
+namespace gcu {
+
+    struct BackoffPolicy
+    {
+        static constexpr std::size_t unlimited = std::numeric_limits< std::size_t >::max();
+
+        std::chrono::milliseconds initialDelay { 500 };
+        std::chrono::milliseconds maxDelay { 30000 };
+        double multiplier { 2.0 };
+        double jitter { 0.2 };
+        std::size_t maxRetries { 10 };
+    };
+
+    class Backoff
+    {
+    public:
+        explicit Backoff( BackoffPolicy const& policy = {} );
+
+        BackoffPolicy const& policy() const { return policy_; }
+        void policy( BackoffPolicy const& policy ) { policy_ = policy; }
+
+        std::size_t attempts() const { return attempts_; }
+        bool exhausted() const;
+
+        std::chrono::milliseconds next();
+        void reset();
+
+    private:
+        BackoffPolicy policy_;
+        std::size_t attempts_ {};
+        double delay_ {};
+        std::minstd_rand random_;
+    };
+
+} // namespace gcu
+
+#endif //GCODEUPLOADER_BACKOFF_HPP
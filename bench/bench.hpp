@@ -0,0 +1,50 @@
+#ifndef GCODEUPLOADER_BENCH_HPP
+#define GCODEUPLOADER_BENCH_HPP
+
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace gcu {
+    namespace bench {
+
+        // keeps the optimizer from dropping a result that is otherwise unused
+        template< typename T >
+        void keep( T const& value )
+        {
+            asm volatile( "" : : "g"( &value ) : "memory" );
+        }
+
+        // Runs the function in rounds of the given size and prints the median time per call, which is less
+        // sensitive to a noisy machine than the mean
+        template< typename Func >
+        double measure( std::string const& name, std::size_t iterations, Func&& func, std::size_t rounds = 9 )
+        {
+            func();
+
+            std::vector< double > perCall;
+            perCall.reserve( rounds );
+            for ( std::size_t round = 0; round < rounds; ++round ) {
+                auto start = std::chrono::steady_clock::now();
+                for ( std::size_t i = 0; i < iterations; ++i ) {
+                    func();
+                }
+                std::chrono::duration< double, std::nano > elapsed = std::chrono::steady_clock::now() - start;
+                perCall.push_back( elapsed.count() / iterations );
+            }
+            std::sort( perCall.begin(), perCall.end() );
+            auto median = perCall[ rounds / 2 ];
+
+            std::cout << std::left << std::setw( 40 ) << name << std::right << std::setw( 14 ) << std::fixed
+                      << std::setprecision( 1 ) << median << " ns/call\n";
+            return median;
+        }
+
+    } // namespace bench
+} // namespace gcu
+
+#endif //GCODEUPLOADER_BENCH_HPP
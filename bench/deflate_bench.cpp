@@ -0,0 +1,357 @@
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+#include <asio/ip/tcp.hpp>
+#include <asio/write.hpp>
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+
+#include "bench.hpp"
+#include "executor.hpp"
+#include "json_reader.hpp"
+#include "payloads.hpp"
+#include "repetier_action.hpp"
+#include "repetier_client.hpp"
+#include "repetier_decoder.hpp"
+#include "repetier_schema.hpp"
+
+using namespace gcu;
+
+// Raw deflate streams as permessage-deflate uses them: a stream per direction, every message flushed with
+// Z_SYNC_FLUSH. Without context takeover the stream is reset after each message.
+class Deflater
+{
+public:
+    Deflater( int windowBits, bool takeover )
+            : takeover_( takeover )
+    {
+        deflateInit2( &stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -windowBits, 8, Z_DEFAULT_STRATEGY );
+    }
+
+    ~Deflater() { deflateEnd( &stream_ ); }
+
+    std::string compress( std::string const& message )
+    {
+        std::string out( deflateBound( &stream_, (uLong) message.size() ) + 16, '\0' );
+        stream_.next_in = (Bytef*) message.data();
+        stream_.avail_in = (uInt) message.size();
+        stream_.next_out = (Bytef*) &out[ 0 ];
+        stream_.avail_out = (uInt) out.size();
+        deflate( &stream_, Z_SYNC_FLUSH );
+        out.resize( out.size() - stream_.avail_out );
+        if ( !takeover_ ) {
+            deflateReset( &stream_ );
+        }
+        return out;
+    }
+
+private:
+    z_stream stream_ {};
+    bool takeover_;
+};
+
+class Inflater
+{
+public:
+    Inflater( int windowBits, bool takeover )
+            : takeover_( takeover )
+    {
+        inflateInit2( &stream_, -windowBits );
+    }
+
+    ~Inflater() { inflateEnd( &stream_ ); }
+
+    std::size_t decompress( std::string const& message, std::string& out )
+    {
+        stream_.next_in = (Bytef*) message.data();
+        stream_.avail_in = (uInt) message.size();
+        stream_.next_out = (Bytef*) &out[ 0 ];
+        stream_.avail_out = (uInt) out.size();
+        inflate( &stream_, Z_SYNC_FLUSH );
+        auto size = out.size() - stream_.avail_out;
+        if ( !takeover_ ) {
+            inflateReset( &stream_ );
+        }
+        return size;
+    }
+
+private:
+    z_stream stream_ {};
+    bool takeover_;
+};
+
+static std::vector< repetier::Model > decode( std::string_view payload )
+{
+    std::error_code ec;
+    json::Reader reader( payload );
+    return repetier::decode::models( reader, ec );
+}
+
+// the messages of one connection, in order, as a takeover inflater has to see them
+static std::vector< std::string > refreshes(
+        std::string const& payload, int windowBits, bool takeover, std::size_t count )
+{
+    Deflater deflater( windowBits, takeover );
+    std::vector< std::string > messages;
+    messages.reserve( count );
+    for ( std::size_t i = 0; i < count; ++i ) {
+        messages.push_back( deflater.compress( payload ) );
+    }
+    return messages;
+}
+
+static void compressionSettings( std::size_t count )
+{
+    auto payload = bench::modelList( count );
+    auto iterations = 10000 / count;
+    std::cout << count << " models, " << payload.size() << " bytes uncompressed\n";
+    bench::measure( "  decode only", iterations, [&] { bench::keep( decode( payload ) ); } );
+
+    for ( int windowBits : { 9, 15 } ) {
+        for ( bool takeover : { false, true } ) {
+            // measure() makes one warm-up call and nine rounds, each call receives the next refresh
+            auto messages = refreshes( payload, windowBits, takeover, 1 + 9 * iterations );
+
+            auto label = "window " + std::to_string( windowBits ) + ( takeover ? ", takeover" : ", no takeover" );
+            std::cout << "  " << label << ": " << messages[ 1 ].size() << " bytes on the wire ("
+                      << 100.0 * messages[ 1 ].size() / payload.size() << "%)\n";
+
+            std::string out( payload.size(), '\0' );
+            Inflater inflater( windowBits, takeover );
+            std::size_t next {};
+            bench::measure( "    inflate + decode", iterations, [&] {
+                auto size = inflater.decompress( messages[ next++ ], out );
+                bench::keep( decode( std::string_view( out.data(), size ) ) );
+            } );
+        }
+    }
+}
+
+using Server = websocketpp::server< repetier::detail::Compressed< websocketpp::config::asio > >;
+
+// Answers login and listModels like a Repetier server, compressing when the client's offer is accepted
+class MockServer
+{
+public:
+    explicit MockServer( std::string payload )
+            : payload_( std::move( payload ) )
+            , executor_( 1 )
+    {
+        server_.clear_access_channels( websocketpp::log::alevel::all );
+        server_.clear_error_channels( websocketpp::log::elevel::all );
+        server_.init_asio( &executor_.service() );
+        server_.set_open_handler( [this]( websocketpp::connection_hdl handle ) {
+            auto connection = server_.get_con_from_hdl( handle );
+            std::lock_guard< std::mutex > lock( mutex_ );
+            offered_ = connection->get_request_header( "Sec-WebSocket-Extensions" );
+            accepted_ = connection->get_response_header( "Sec-WebSocket-Extensions" );
+        } );
+        server_.set_message_handler( [this]( websocketpp::connection_hdl handle, Server::message_ptr message ) {
+            this->answer( handle, message->get_payload() );
+        } );
+        server_.listen( asio::ip::tcp::endpoint( asio::ip::address_v4::loopback(), 0 ) );
+        server_.start_accept();
+    }
+
+    ~MockServer()
+    {
+        executor_.service().post( [this] {
+            std::error_code ec;
+            server_.stop_listening( ec );
+        } );
+    }
+
+    std::uint16_t port()
+    {
+        std::error_code ec;
+        return server_.get_local_endpoint( ec ).port();
+    }
+
+    std::string offered() const
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        return offered_;
+    }
+
+    std::string accepted() const
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        return accepted_;
+    }
+
+private:
+    void answer( websocketpp::connection_hdl handle, std::string const& request )
+    {
+        std::string action;
+        std::intmax_t callbackId = -1;
+        std::string_view key;
+        json::Reader reader( request );
+        reader.beginObject();
+        while ( reader.nextMember( key ) ) {
+            if ( key == "action" ) {
+                action = reader.readString();
+            }
+            else if ( key == "callback_id" ) {
+                callbackId = reader.readInteger();
+            }
+            else {
+                reader.skipValue();
+            }
+        }
+
+        auto response = "{\"callback_id\":" + std::to_string( callbackId ) + ",";
+        response += action == "listModels" ? payload_.substr( 1 ) : "\"data\":{\"ok\":true}}";
+        std::error_code ec;
+        server_.send( handle, response, websocketpp::frame::opcode::text, ec );
+    }
+
+    std::string payload_;
+    mutable std::mutex mutex_;
+    std::string offered_;
+    std::string accepted_;
+    // destroyed after the executor has run out of work
+    Server server_;
+    Executor executor_;
+};
+
+// Forwards the client's connection to the server and counts what the server sends, frame headers included
+class Relay
+{
+public:
+    explicit Relay( std::uint16_t target )
+            : acceptor_( service_, asio::ip::tcp::endpoint( asio::ip::address_v4::loopback(), 0 ) )
+    {
+        thread_ = std::thread( [this, target] { this->run( target ); } );
+    }
+
+    ~Relay() { thread_.join(); }
+
+    std::uint16_t port() const { return acceptor_.local_endpoint().port(); }
+    std::size_t received() const { return received_; }
+
+private:
+    void run( std::uint16_t target )
+    {
+        asio::ip::tcp::socket client( service_ );
+        asio::ip::tcp::socket server( service_ );
+        acceptor_.accept( client );
+        server.connect( asio::ip::tcp::endpoint( asio::ip::address_v4::loopback(), target ) );
+
+        std::thread upstream( [&] { pump( client, server, nullptr ); } );
+        pump( server, client, &received_ );
+        upstream.join();
+    }
+
+    static void pump( asio::ip::tcp::socket& from, asio::ip::tcp::socket& to, std::atomic< std::size_t >* counter )
+    {
+        std::array< char, 64 * 1024 > buffer;
+        std::error_code ec;
+        while ( true ) {
+            auto count = from.read_some( asio::buffer( buffer ), ec );
+            if ( ec ) {
+                break;
+            }
+            if ( counter ) {
+                *counter += count;
+            }
+            asio::write( to, asio::buffer( buffer.data(), count ), ec );
+            if ( ec ) {
+                break;
+            }
+        }
+        to.shutdown( asio::ip::tcp::socket::shutdown_send, ec );
+    }
+
+    asio::io_service service_;
+    asio::ip::tcp::acceptor acceptor_;
+    std::atomic< std::size_t > received_ {};
+    std::thread thread_;
+};
+
+// Refreshes the model list through Client, so the extension offer is the one the client writes and every answer
+// is inflated by websocketpp and decoded by the schema
+static bool roundTrips( std::size_t count, bool compressed )
+{
+    auto payload = bench::modelList( count );
+    auto iterations = 1000 / count;
+
+    MockServer server( payload );
+    Relay relay( server.port() );
+    Executor executor( 1 );
+    auto client = std::make_shared< repetier::Client >( executor.service() );
+
+    repetier::CompressionSettings settings;
+    settings.enabled = compressed;
+    client->compression( settings );
+
+    std::promise< std::error_code > connected;
+    client->connect( "127.0.0.1", relay.port(), "bench", [&connected]( std::error_code ec ) {
+        connected.set_value( ec );
+    } );
+    auto ec = connected.get_future().get();
+
+    bool result = !ec;
+    if ( ec ) {
+        std::cerr << "  connecting to the mock server failed: " << ec.message() << "\n";
+    }
+    else if ( compressed && server.accepted().find( "permessage-deflate" ) == std::string::npos ) {
+        std::cerr << "  the server declined the offer \"" << server.offered() << "\"\n";
+        result = false;
+    }
+    else {
+        if ( compressed ) {
+            std::cout << "  offered:  " << server.offered() << "\n  accepted: " << server.accepted() << "\n";
+        }
+
+        auto before = relay.received();
+        std::size_t calls {};
+        bench::measure( compressed ? "  listModels, compressed" : "  listModels, uncompressed", iterations, [&] {
+            std::promise< std::size_t > answered;
+            repetier::makeAction< repetier::schema::ListModels >( client.get() )
+                    .printer( "bench" )
+                    .send( [&answered]( std::vector< repetier::Model > models, std::error_code ec ) {
+                        answered.set_value( ec ? 0 : models.size() );
+                    } );
+            if ( answered.get_future().get() != count ) {
+                result = false;
+            }
+            ++calls;
+        } );
+        std::cout << "    " << ( relay.received() - before ) / calls << " bytes received per refresh\n";
+        if ( !result ) {
+            std::cerr << "  listModels did not return " << count << " models\n";
+        }
+    }
+
+    client->shutdown();
+    return result;
+}
+
+int main()
+{
+    // a model list refresh repeats mostly the same answer, which context takeover compresses against the last one
+    for ( std::size_t count : { 10, 100, 1000 } ) {
+        compressionSettings( count );
+    }
+
+    std::cout << "through Client against a local mock server\n";
+    bool ok = true;
+    for ( std::size_t count : { 10, 100, 1000 } ) {
+        std::cout << count << " models\n";
+        ok = roundTrips( count, false ) && roundTrips( count, true ) && ok;
+    }
+    return ok ? 0 : 1;
+}
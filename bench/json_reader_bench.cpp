@@ -0,0 +1,99 @@
+#include <cstdint>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <json.hpp>
+
+#include "bench.hpp"
+#include "payloads.hpp"
+#include "json_reader.hpp"
+#include "repetier_decoder.hpp"
+
+using namespace gcu;
+
+// what listModels did before the streaming reader: a DOM of the whole answer, then a conversion per model
+static std::vector< repetier::Model > decodeDom( std::string const& payload )
+{
+    auto data = nlohmann::json::parse( payload )[ "data" ];
+    std::vector< repetier::Model > result;
+    for ( auto const& model : data ) {
+        result.emplace_back(
+                model[ "id" ], model[ "name" ], model[ "group" ],
+                model[ "created" ].get< std::size_t >() / 1000, model[ "length" ], model[ "layer" ], model[ "lines" ],
+                std::chrono::milliseconds( (std::uint64_t) ( model[ "printTime" ].get< double >() * 1000.0 ) ) );
+    }
+    return result;
+}
+
+static std::vector< repetier::Model > decodeStream( std::string const& payload )
+{
+    std::error_code ec;
+    json::Reader reader( payload );
+    return repetier::decode::models( reader, ec );
+}
+
+// what the removed prescan cost: walking the data array once more only to count its elements
+static std::size_t countModels( std::string const& payload )
+{
+    std::size_t count {};
+    std::string_view key;
+    json::Reader reader( payload );
+    reader.beginObject();
+    while ( reader.nextMember( key ) ) {
+        if ( key != "data" ) {
+            reader.skipValue();
+            continue;
+        }
+        reader.beginArray();
+        while ( reader.nextElement() ) {
+            reader.skipValue();
+            ++count;
+        }
+    }
+    return count;
+}
+
+// what the reservation saved at most: the reallocations of a vector growing to the same size
+static std::vector< repetier::Model > collect( std::vector< repetier::Model > const& models, bool reserve )
+{
+    std::vector< repetier::Model > result;
+    if ( reserve ) {
+        result.reserve( models.size() );
+    }
+    for ( auto const& model : models ) {
+        result.push_back( model );
+    }
+    return result;
+}
+
+int main()
+{
+    for ( std::size_t count : { 10, 100, 1000 } ) {
+        auto payload = bench::modelList( count );
+        if ( decodeDom( payload ).size() != count || decodeStream( payload ).size() != count ) {
+            std::cerr << "decoders disagree on " << count << " models\n";
+            return 1;
+        }
+
+        auto iterations = 10000 / count;
+        std::cout << count << " models, " << payload.size() << " bytes\n";
+        auto dom = bench::measure( "  nlohmann DOM", iterations, [&] { bench::keep( decodeDom( payload ) ); } );
+        auto stream = bench::measure( "  json::Reader", iterations, [&] { bench::keep( decodeStream( payload ) ); } );
+        std::cout << "  speedup " << dom / stream << "x\n";
+
+        auto models = decodeStream( payload );
+        auto prescan = bench::measure( "  prescan of the data array", iterations, [&] {
+            bench::keep( countModels( payload ) );
+        } );
+        auto growing = bench::measure( "  collect, growing vector", iterations, [&] {
+            bench::keep( collect( models, false ) );
+        } );
+        auto reserved = bench::measure( "  collect, reserved vector", iterations, [&] {
+            bench::keep( collect( models, true ) );
+        } );
+        std::cout << "  reserving saves " << growing - reserved << " ns, the prescan costs " << prescan << " ns\n";
+    }
+}
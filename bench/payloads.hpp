@@ -0,0 +1,32 @@
+#ifndef GCODEUPLOADER_PAYLOADS_HPP
+#define GCODEUPLOADER_PAYLOADS_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace gcu {
+    namespace bench {
+
+        // a listModels answer the size of a busy printer, with the members the decoder skips
+        inline std::string modelList( std::size_t count )
+        {
+            std::string payload = "{\"data\":[";
+            for ( std::size_t i = 0; i < count; ++i ) {
+                auto id = std::to_string( i + 1 );
+                payload += ( i > 0 ? "," : "" );
+                payload += "{\"analysed\":1,\"created\":1508241234000,\"extruder\":[{\"filament\":1234.5}],"
+                           "\"filamentTotal\":1234.5,\"group\":\"Group " + std::to_string( i % 7 ) + "\","
+                           "\"id\":" + id + ",\"layer\":" + std::to_string( 100 + i ) + ","
+                           "\"length\":" + std::to_string( 100000 + i * 17 ) + ","
+                           "\"lines\":" + std::to_string( 50000 + i ) + ",\"name\":\"Model \\u00e4 " + id + "\","
+                           "\"notes\":\"\",\"printTime\":" + std::to_string( 3600.5 + i ) + ",\"printed\":0,"
+                           "\"radius\":45.2,\"radiusMove\":60.1,\"slicer\":\"Slic3r\",\"version\":2,\"volume\":12.5}";
+            }
+            payload += "]}";
+            return payload;
+        }
+
+    } // namespace bench
+} // namespace gcu
+
+#endif //GCODEUPLOADER_PAYLOADS_HPP
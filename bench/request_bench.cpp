@@ -0,0 +1,60 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include <json.hpp>
+
+#include "bench.hpp"
+#include "json_writer.hpp"
+
+using namespace gcu;
+
+static char const* const printer = "Prusa_i3_MK2";
+static char const* const groupName = "Calibration \"cubes\"";
+
+// how a moveModelFileToGroup request was built and sent before the writer: a DOM, dumped on every send
+static std::string buildDom( std::intmax_t callbackId )
+{
+    nlohmann::json request;
+    request[ "action" ] = "moveModelFileToGroup";
+    request[ "data" ][ "groupName" ] = groupName;
+    request[ "data" ][ "id" ] = 4711;
+    request[ "printer" ] = printer;
+    request[ "callback_id" ] = callbackId;
+    return request.dump();
+}
+
+// the builder serializes into the request buffer, the client wraps it with the callback id into its send buffer
+static void buildWriter( std::string& request, std::string& sendBuffer, std::intmax_t callbackId )
+{
+    request.clear();
+    json::Writer( request ).key( "action" ).value( "moveModelFileToGroup" ).key( "data" ).beginObject()
+            .key( "groupName" ).value( groupName ).key( "id" ).value( 4711 ).endObject()
+            .key( "printer" ).value( printer );
+
+    sendBuffer.clear();
+    json::Writer( sendBuffer ).beginObject().key( "callback_id" ).value( callbackId ).raw( request ).endObject();
+}
+
+int main()
+{
+    std::intmax_t callbackId = 0;
+    auto dom = bench::measure( "nlohmann DOM + dump", 100000, [&] { bench::keep( buildDom( ++callbackId ) ); } );
+
+    // the send buffer is reused by the client either way, the request buffer only since requests are recycled
+    std::string sendBuffer;
+    auto fresh = bench::measure( "json::Writer, new request buffer", 100000, [&] {
+        std::string request;
+        request.reserve( 128 );
+        buildWriter( request, sendBuffer, ++callbackId );
+        bench::keep( sendBuffer );
+    } );
+
+    std::string request;
+    auto reused = bench::measure( "json::Writer, reused buffers", 100000, [&] {
+        buildWriter( request, sendBuffer, ++callbackId );
+        bench::keep( sendBuffer );
+    } );
+
+    std::cout << "writer is " << dom / fresh << "x faster, " << dom / reused << "x with reused buffers\n";
+}
@@ -0,0 +1,154 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Sends a G-code sized file over loopback TCP to a thread that discards it, once through a 64 KiB userspace buffer
+// like TLS uploads and once with sendfile() like plain ones. Wall time is bounded by the receiver on loopback, the
+// CPU time of the sending thread is what sendfile() saves.
+
+static constexpr std::size_t fileSize = 256 * 1024 * 1024;
+static constexpr std::size_t chunkSize = 64 * 1024;
+
+struct Result
+{
+    double seconds;
+    double cpuSeconds;
+};
+
+static double threadCpuSeconds()
+{
+    timespec ts {};
+    clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fail( char const* what )
+{
+    std::perror( what );
+    std::exit( 1 );
+}
+
+template< typename Send >
+static Result transfer( int file, Send&& send )
+{
+    int listener = ::socket( AF_INET, SOCK_STREAM, 0 );
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    socklen_t length = sizeof( address );
+    if ( ::bind( listener, (sockaddr*) &address, length ) != 0 || ::listen( listener, 1 ) != 0 ||
+         ::getsockname( listener, (sockaddr*) &address, &length ) != 0 ) {
+        fail( "listen" );
+    }
+
+    std::thread receiver( [listener] {
+        int connection = ::accept( listener, nullptr, nullptr );
+        std::vector< char > buffer( 1024 * 1024 );
+        while ( ::read( connection, buffer.data(), buffer.size() ) > 0 ) {
+        }
+        ::close( connection );
+    } );
+
+    int sender = ::socket( AF_INET, SOCK_STREAM, 0 );
+    if ( ::connect( sender, (sockaddr*) &address, length ) != 0 ) {
+        fail( "connect" );
+    }
+
+    ::lseek( file, 0, SEEK_SET );
+    auto start = std::chrono::steady_clock::now();
+    auto cpuStart = threadCpuSeconds();
+    send( file, sender );
+    auto cpu = threadCpuSeconds() - cpuStart;
+    ::shutdown( sender, SHUT_WR );
+    receiver.join();
+    std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+
+    ::close( sender );
+    ::close( listener );
+    return { elapsed.count(), cpu };
+}
+
+static void readWrite( int file, int socket )
+{
+    std::vector< char > chunk( chunkSize );
+    ssize_t count;
+    while ( ( count = ::read( file, chunk.data(), chunk.size() ) ) > 0 ) {
+        for ( ssize_t written = 0; written < count; ) {
+            auto result = ::write( socket, chunk.data() + written, (std::size_t) ( count - written ) );
+            if ( result < 0 ) {
+                fail( "write" );
+            }
+            written += result;
+        }
+    }
+}
+
+static void sendFile( int file, int socket )
+{
+    off_t offset = 0;
+    while ( offset < (off_t) fileSize ) {
+        if ( ::sendfile( socket, file, &offset, fileSize - (std::size_t) offset ) < 0 ) {
+            fail( "sendfile" );
+        }
+    }
+}
+
+// median of a few transfers by wall time, loopback throughput varies a lot with scheduling
+template< typename Send >
+static void measure( char const* name, int file, Send&& send, std::size_t rounds = 5 )
+{
+    std::vector< Result > results;
+    for ( std::size_t round = 0; round < rounds; ++round ) {
+        results.push_back( transfer( file, send ) );
+    }
+    std::sort( results.begin(), results.end(), []( Result const& a, Result const& b ) {
+        return a.seconds < b.seconds;
+    } );
+    auto const& result = results[ rounds / 2 ];
+
+    auto megabytes = fileSize / ( 1024.0 * 1024.0 );
+    std::cout << std::left << std::setw( 16 ) << name << std::right << std::fixed << std::setprecision( 1 )
+              << std::setw( 8 ) << megabytes / result.seconds << " MB/s, " << std::setprecision( 3 )
+              << result.cpuSeconds << " s CPU in the sender\n";
+}
+
+int main()
+{
+    char path[] = "/tmp/gcu_sendfile_benchXXXXXX";
+    int file = ::mkstemp( path );
+    if ( file == -1 ) {
+        fail( "mkstemp" );
+    }
+    ::unlink( path );
+
+    std::string line = "G1 X100.123 Y100.456 E1.23456 F1800\n";
+    std::string block;
+    while ( block.size() < chunkSize ) {
+        block += line;
+    }
+    for ( std::size_t written = 0; written < fileSize; written += chunkSize ) {
+        if ( ::write( file, block.data(), chunkSize ) != (ssize_t) chunkSize ) {
+            fail( "write" );
+        }
+    }
+
+    // the first pass pulls the file into the page cache, so both see the same warm file
+    transfer( file, readWrite );
+    measure( "read + write", file, readWrite );
+    measure( "sendfile", file, sendFile );
+    ::close( file );
+}
@@ -0,0 +1,38 @@
+#ifndef GCODEUPLOADER_CANCELLATION_HPP
+#define GCODEUPLOADER_CANCELLATION_HPP
+
+#include <atomic>
+#include <memory>
+
+namespace gcu {
+
+    // Shared flag handed along with a request. A default constructed token is never cancelled, so it can be passed
+    // wherever the caller does not care.
+    class CancellationToken
+    {
+    public:
+        CancellationToken() = default;
+
+        static CancellationToken create()
+        {
+            CancellationToken token;
+            token.state_ = std::make_shared< std::atomic< bool > >( false );
+            return token;
+        }
+
+        void cancel() const
+        {
+            if ( state_ ) {
+                *state_ = true;
+            }
+        }
+
+        bool cancelled() const { return state_ && *state_; }
+
+    private:
+        std::shared_ptr< std::atomic< bool > > state_;
+    };
+
+} // namespace gcu
+
+#endif // GCODEUPLOADER_CANCELLATION_HPP
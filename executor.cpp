@@ -0,0 +1,37 @@
+#include <algorithm>
+
+#include "executor.hpp"
+#include "log.hpp"
+
+namespace gcu {
+
+    Executor::Executor( std::size_t threads )
+    {
+        if ( threads == 0 ) {
+            threads = std::max< std::size_t >( std::thread::hardware_concurrency(), 1 );
+        }
+
+        GCU_LOG_DEBUG( "Starting executor with ", threads, " io threads" );
+
+        threads_.reserve( threads );
+        for ( std::size_t i = 0; i < threads; ++i ) {
+            threads_.emplace_back( [this] { service_.run(); } );
+        }
+    }
+
+    bool Executor::inPool() const
+    {
+        auto id = std::this_thread::get_id();
+        return std::any_of( threads_.begin(), threads_.end(), [id]( auto const& thread ) {
+            return thread.get_id() == id;
+        } );
+    }
+
+    Executor::~Executor()
+    {
+        // lets the threads finish what is queued, connections must have been shut down before
+        work_ = std::nullopt;
+        std::for_each( threads_.begin(), threads_.end(), []( auto& thread ) { thread.join(); } );
+    }
+
+} // namespace gcu
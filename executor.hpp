@@ -0,0 +1,37 @@
+#ifndef GCODEUPLOADER_EXECUTOR_HPP
+#define GCODEUPLOADER_EXECUTOR_HPP
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "std/optional.hpp"
+
+#include <asio/io_service.hpp>
+
+namespace gcu {
+
+    // Pool of io threads shared by all connections; every connection serializes its own work on strands, so the
+    // number of threads no longer depends on the number of servers
+    class Executor
+    {
+    public:
+        // zero sizes the pool to the number of cores
+        explicit Executor( std::size_t threads = 0 );
+        Executor( Executor const& ) = delete;
+        ~Executor();
+
+        asio::io_service& service() { return service_; }
+        std::size_t threads() const { return threads_.size(); }
+        // whether the caller is one of the pool's threads, which must not block on work queued to the pool
+        bool inPool() const;
+
+    private:
+        asio::io_service service_;
+        std::optional< asio::io_service::work > work_ { std::in_place, service_ };
+        std::vector< std::thread > threads_;
+    };
+
+} // namespace gcu
+
+#endif // GCODEUPLOADER_EXECUTOR_HPP
@@ -0,0 +1,431 @@
+#ifndef GCODEUPLOADER_FUTURE_HPP
+#define GCODEUPLOADER_FUTURE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "std/optional.hpp"
+
+namespace gcu {
+
+    template< typename T = void >
+    class Future;
+
+    template< typename T = void >
+    class Promise;
+
+    namespace detail {
+
+        struct Unit {};
+
+        struct Access;
+
+        template< typename T >
+        struct Stored
+        {
+            using type = T;
+        };
+
+        template<>
+        struct Stored< void >
+        {
+            using type = Unit;
+        };
+
+        template< typename T >
+        class FutureState
+        {
+        public:
+            using Value = typename Stored< T >::type;
+            using Continuation = std::function< void ( std::optional< Value >&&, std::error_code ) >;
+
+            // the first completion wins, everything after it is ignored
+            void complete( std::optional< Value >&& value, std::error_code ec )
+            {
+                std::unique_lock< std::mutex > lock( mutex_ );
+                if ( ready_ ) {
+                    return;
+                }
+                ready_ = true;
+                if ( !continuation_ ) {
+                    value_ = std::move( value );
+                    ec_ = ec;
+                    return;
+                }
+
+                auto continuation = std::move( continuation_ );
+                lock.unlock();
+                continuation( std::move( value ), ec );
+            }
+
+            void attach( Continuation&& continuation )
+            {
+                std::unique_lock< std::mutex > lock( mutex_ );
+                if ( !ready_ ) {
+                    continuation_ = std::move( continuation );
+                    return;
+                }
+
+                lock.unlock();
+                continuation( std::move( value_ ), ec_ );
+            }
+
+        private:
+            std::mutex mutex_;
+            bool ready_ {};
+            std::optional< Value > value_;
+            std::error_code ec_;
+            Continuation continuation_;
+        };
+
+        template< typename T >
+        struct IsFuture : std::false_type {};
+
+        template< typename T >
+        struct IsFuture< Future< T > > : std::true_type {};
+
+        template< typename T >
+        struct Unwrapped
+        {
+            using type = T;
+        };
+
+        template< typename T >
+        struct Unwrapped< Future< T > >
+        {
+            using type = T;
+        };
+
+        template< typename T >
+        struct Apply
+        {
+            template< typename Func >
+            static auto call( Func& func, std::optional< T >& value )
+            {
+                return func( std::move( *value ) );
+            }
+
+            template< typename Func >
+            using Result = std::result_of_t< Func( T&& ) >;
+        };
+
+        template<>
+        struct Apply< void >
+        {
+            template< typename Func >
+            static auto call( Func& func, std::optional< Unit >& )
+            {
+                return func();
+            }
+
+            template< typename Func >
+            using Result = std::result_of_t< Func() >;
+        };
+
+        template< typename T, typename Invoker >
+        void fulfil( Promise< T > const& promise, Invoker&& invoker, std::true_type )
+        {
+            invoker();
+            promise.setValue();
+        }
+
+        template< typename T, typename Invoker >
+        void fulfil( Promise< T > const& promise, Invoker&& invoker, std::false_type )
+        {
+            promise.setValue( invoker() );
+        }
+
+    } // namespace detail
+
+    // Callback style completion as a value: continuations chain with then(), run in the thread that completes the
+    // previous step and are skipped once a step failed. finally() ends a chain and sees the error, if any.
+    template< typename T >
+    class Future
+    {
+        template< typename U >
+        friend class Promise;
+
+        template< typename U >
+        friend class Future;
+
+        friend struct detail::Access;
+
+        using State = detail::FutureState< T >;
+
+    public:
+        using Value = typename State::Value;
+
+        Future() = default;
+        Future( Future&& ) = default;
+        Future( Future const& ) = delete;
+
+        Future& operator=( Future&& ) = default;
+        Future& operator=( Future const& ) = delete;
+
+        bool valid() const { return state_ != nullptr; }
+
+        // a continuation returning a future is flattened, so steps can be written as a flat chain
+        template< typename Func >
+        auto then( Func func ) &&
+        {
+            using Result = typename detail::Apply< T >::template Result< Func >;
+            using Next = typename detail::Unwrapped< Result >::type;
+
+            Promise< Next > promise;
+            auto next = promise.future();
+            take()->attach( [promise, func = std::move( func )]( auto&& value, std::error_code ec ) mutable {
+                if ( ec ) {
+                    promise.setError( ec );
+                    return;
+                }
+                forward( promise, func, value, detail::IsFuture< Result >() );
+            } );
+            return next;
+        }
+
+        template< typename Func >
+        void finally( Func func ) &&
+        {
+            take()->attach( [func = std::move( func )]( auto&&, std::error_code ec ) mutable { func( ec ); } );
+        }
+
+    private:
+        explicit Future( std::shared_ptr< State > state ) : state_( std::move( state ) ) {}
+
+        std::shared_ptr< State > take()
+        {
+            return std::move( state_ );
+        }
+
+        template< typename Next, typename Func >
+        static void forward(
+                Promise< Next > const& promise, Func& func, std::optional< Value >& value, std::false_type )
+        {
+            auto invoker = [&] { return detail::Apply< T >::call( func, value ); };
+            detail::fulfil( promise, invoker, std::is_void< Next >() );
+        }
+
+        template< typename Next, typename Func >
+        static void forward(
+                Promise< Next > const& promise, Func& func, std::optional< Value >& value, std::true_type )
+        {
+            detail::Apply< T >::call( func, value ).take()->attach( [promise]( auto&& value, std::error_code ec ) {
+                promise.settle( std::move( value ), ec );
+            } );
+        }
+
+        std::shared_ptr< State > state_;
+    };
+
+    template< typename T >
+    class Promise
+    {
+        template< typename U >
+        friend class Future;
+
+        friend struct detail::Access;
+
+        using State = detail::FutureState< T >;
+
+    public:
+        using Value = typename State::Value;
+
+        Promise() : state_( std::make_shared< State >() ) {}
+
+        Future< T > future() const { return Future< T >( state_ ); }
+
+        template< typename U = T, typename = std::enable_if_t< !std::is_void< U >::value > >
+        void setValue( Value value ) const
+        {
+            settle( std::optional< Value >( std::move( value ) ), {} );
+        }
+
+        template< typename U = T, typename = std::enable_if_t< std::is_void< U >::value > >
+        void setValue() const
+        {
+            settle( std::optional< Value >( Value() ), {} );
+        }
+
+        void setError( std::error_code ec ) const
+        {
+            state_->complete( std::nullopt, ec );
+        }
+
+        // adapts the repetier::Callback<> convention
+        template< typename U = T, typename = std::enable_if_t< std::is_void< U >::value > >
+        void complete( std::error_code ec ) const
+        {
+            if ( ec ) {
+                setError( ec );
+            }
+            else {
+                setValue();
+            }
+        }
+
+    private:
+        void settle( std::optional< Value >&& value, std::error_code ec ) const
+        {
+            state_->complete( std::move( value ), ec );
+        }
+
+        std::shared_ptr< State > state_;
+    };
+
+    inline Future<> makeReadyFuture()
+    {
+        Promise<> promise;
+        promise.setValue();
+        return promise.future();
+    }
+
+    template< typename T >
+    Future< std::decay_t< T > > makeReadyFuture( T&& value )
+    {
+        Promise< std::decay_t< T > > promise;
+        promise.setValue( std::forward< T >( value ) );
+        return promise.future();
+    }
+
+    template< typename T = void >
+    Future< T > makeFailedFuture( std::error_code ec )
+    {
+        Promise< T > promise;
+        promise.setError( ec );
+        return promise.future();
+    }
+
+    namespace detail {
+
+        template< typename T >
+        struct Gathered
+        {
+            explicit Gathered( std::size_t size ) : remaining( size ), values( size ) {}
+
+            std::mutex mutex;
+            std::size_t remaining;
+            std::vector< std::optional< typename Stored< T >::type > > values;
+        };
+
+        struct Access
+        {
+            template< typename T >
+            static auto state( Future< T >& future )
+            {
+                return future.take();
+            }
+
+            template< typename T >
+            static void settle(
+                    Promise< T > const& promise, std::optional< typename Stored< T >::type >&& value,
+                    std::error_code ec )
+            {
+                promise.settle( std::move( value ), ec );
+            }
+        };
+
+        inline Unit collect( std::vector< std::optional< Unit > >& )
+        {
+            return {};
+        }
+
+        template< typename T >
+        std::vector< T > collect( std::vector< std::optional< T > >& values )
+        {
+            std::vector< T > result;
+            result.reserve( values.size() );
+            for ( auto& value : values ) {
+                result.push_back( std::move( *value ) );
+            }
+            return result;
+        }
+
+        template< typename T, typename Result >
+        Future< Result > gather( std::vector< Future< T > >&& futures )
+        {
+            Promise< Result > promise;
+            auto result = promise.future();
+            if ( futures.empty() ) {
+                std::vector< std::optional< typename Stored< T >::type > > none;
+                Access::settle( promise, std::make_optional( collect( none ) ), {} );
+                return result;
+            }
+
+            auto gathered = std::make_shared< Gathered< T > >( futures.size() );
+            for ( std::size_t i = 0; i < futures.size(); ++i ) {
+                Access::state( futures[ i ] )->attach( [promise, gathered, i]( auto&& value, std::error_code ec ) {
+                    if ( ec ) {
+                        promise.setError( ec );
+                        return;
+                    }
+
+                    std::unique_lock< std::mutex > lock( gathered->mutex );
+                    gathered->values[ i ] = std::move( value );
+                    if ( --gathered->remaining == 0 ) {
+                        lock.unlock();
+                        Access::settle( promise, std::make_optional( collect( gathered->values ) ), {} );
+                    }
+                } );
+            }
+            return result;
+        }
+
+        struct Settled
+        {
+            explicit Settled( std::size_t size ) : remaining( size ) {}
+
+            std::mutex mutex;
+            std::size_t remaining;
+            std::error_code ec;
+        };
+
+    } // namespace detail
+
+    // completes once all futures did, or with the first error; the values keep the order of the futures
+    template< typename T >
+    Future< std::vector< T > > whenAll( std::vector< Future< T > > futures )
+    {
+        return detail::gather< T, std::vector< T > >( std::move( futures ) );
+    }
+
+    inline Future<> whenAll( std::vector< Future<> > futures )
+    {
+        return detail::gather< void, void >( std::move( futures ) );
+    }
+
+    // completes only once every future did, failed ones included, with the first error if there was any
+    inline Future<> whenAllSettled( std::vector< Future<> > futures )
+    {
+        Promise<> promise;
+        auto result = promise.future();
+        if ( futures.empty() ) {
+            promise.setValue();
+            return result;
+        }
+
+        auto settled = std::make_shared< detail::Settled >( futures.size() );
+        for ( auto& future : futures ) {
+            std::move( future ).finally( [promise, settled]( std::error_code ec ) {
+                std::unique_lock< std::mutex > lock( settled->mutex );
+                if ( ec && !settled->ec ) {
+                    settled->ec = ec;
+                }
+                if ( --settled->remaining == 0 ) {
+                    auto first = settled->ec;
+                    lock.unlock();
+                    promise.complete( first );
+                }
+            } );
+        }
+        return result;
+    }
+
+} // namespace gcu
+
+#endif // GCODEUPLOADER_FUTURE_HPP
@@ -1,4 +1,5 @@
 #include <ostream>
+#include <string>
 #include <utility>
 
 #include "http.hpp"
@@ -17,8 +18,48 @@ namespace gcu {
             return { "ws", port };
         }
 
+        std::tuple< char const*, std::uint16_t > https( std::uint16_t port )
+        {
+            return { "https", port };
+        }
+
+        std::tuple< char const*, std::uint16_t > wss( std::uint16_t port )
+        {
+            return { "wss", port };
+        }
+
     } // namespace url
 
+    namespace http {
+
+        class StatusCategory
+                : public std::error_category
+        {
+        public:
+            char const* name() const noexcept override
+            {
+                return "http";
+            }
+
+            std::string message( int status ) const override
+            {
+                return "HTTP status " + std::to_string( status );
+            }
+        };
+
+        std::error_category const& statusCategory()
+        {
+            static StatusCategory category;
+            return category;
+        }
+
+        std::error_code statusError( unsigned status )
+        {
+            return std::error_code( (int) status, statusCategory() );
+        }
+
+    } // namespace http
+
     Url::Url( url::Protocol protocol, String host )
             : Url( std::move( protocol ), std::move( host ), std::vector< String > {} )
     {
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <iosfwd>
 #include <string>
+#include <system_error>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -18,9 +19,20 @@ namespace gcu {
 
         std::tuple< char const*, std::uint16_t > http( std::uint16_t port = 80 );
         std::tuple< char const*, std::uint16_t > ws( std::uint16_t port = 80 );
+        std::tuple< char const*, std::uint16_t > https( std::uint16_t port = 443 );
+        std::tuple< char const*, std::uint16_t > wss( std::uint16_t port = 443 );
 
     } // namespace url
 
+    namespace http {
+
+        // error codes carrying the HTTP status of a response as their value
+        std::error_category const& statusCategory();
+
+        std::error_code statusError( unsigned status );
+
+    } // namespace http
+
     class Url
     {
     public:
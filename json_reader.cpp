@@ -0,0 +1,336 @@
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "json_reader.hpp"
+
+namespace gcu {
+    namespace json {
+
+        static constexpr std::size_t maxNumberLength = 64;
+
+        static bool isDelimiter( char c )
+        {
+            return c == ',' || c == '}' || c == ']' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        }
+
+        static int hexValue( char c )
+        {
+            return c >= '0' && c <= '9' ? c - '0' :
+                   c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                   c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        }
+
+        static void appendUtf8( std::string& out, std::uint32_t codepoint )
+        {
+            if ( codepoint < 0x80 ) {
+                out += (char) codepoint;
+            }
+            else if ( codepoint < 0x800 ) {
+                out += (char) ( 0xc0 | ( codepoint >> 6 ) );
+                out += (char) ( 0x80 | ( codepoint & 0x3f ) );
+            }
+            else if ( codepoint < 0x10000 ) {
+                out += (char) ( 0xe0 | ( codepoint >> 12 ) );
+                out += (char) ( 0x80 | ( ( codepoint >> 6 ) & 0x3f ) );
+                out += (char) ( 0x80 | ( codepoint & 0x3f ) );
+            }
+            else {
+                out += (char) ( 0xf0 | ( codepoint >> 18 ) );
+                out += (char) ( 0x80 | ( ( codepoint >> 12 ) & 0x3f ) );
+                out += (char) ( 0x80 | ( ( codepoint >> 6 ) & 0x3f ) );
+                out += (char) ( 0x80 | ( codepoint & 0x3f ) );
+            }
+        }
+
+        Reader::Reader( std::string_view text )
+                : pos_( text.data() )
+                , end_( text.data() + text.size() )
+        {
+        }
+
+        Reader::Type Reader::peek()
+        {
+            skipWhitespace();
+            if ( pos_ == end_ ) {
+                return INVALID;
+            }
+            switch ( *pos_ ) {
+                case '{': return OBJECT;
+                case '[': return ARRAY;
+                case '"': return STRING;
+                case 't':
+                case 'f': return BOOLEAN;
+                case 'n': return NULLVALUE;
+                default: return *pos_ == '-' || ( *pos_ >= '0' && *pos_ <= '9' ) ? NUMBER : INVALID;
+            }
+        }
+
+        void Reader::beginObject()
+        {
+            if ( !consume( '{' ) ) {
+                fail();
+            }
+        }
+
+        bool Reader::nextMember( std::string_view& key )
+        {
+            if ( failed_ || consume( '}' ) ) {
+                return false;
+            }
+            consume( ',' );
+            key = readRawString();
+            if ( !consume( ':' ) ) {
+                fail();
+            }
+            return !failed_;
+        }
+
+        void Reader::beginArray()
+        {
+            if ( !consume( '[' ) ) {
+                fail();
+            }
+        }
+
+        bool Reader::nextElement()
+        {
+            if ( failed_ || consume( ']' ) ) {
+                return false;
+            }
+            consume( ',' );
+            return true;
+        }
+
+        std::string Reader::readString()
+        {
+            auto raw = readRawString();
+            if ( std::find( raw.begin(), raw.end(), '\\' ) == raw.end() ) {
+                return std::string( raw.data(), raw.size() );
+            }
+
+            std::string result;
+            result.reserve( raw.size() );
+            for ( auto it = raw.begin(); it != raw.end(); ++it ) {
+                if ( *it != '\\' ) {
+                    result += *it;
+                    continue;
+                }
+                if ( ++it == raw.end() ) {
+                    break;
+                }
+                switch ( *it ) {
+                    case 'b': result += '\b'; break;
+                    case 'f': result += '\f'; break;
+                    case 'n': result += '\n'; break;
+                    case 'r': result += '\r'; break;
+                    case 't': result += '\t'; break;
+                    case 'u': {
+                        auto readHex = [&]( std::uint32_t& value ) {
+                            value = 0;
+                            for ( int i = 0; i < 4; ++i ) {
+                                int digit;
+                                if ( ++it == raw.end() || ( digit = hexValue( *it ) ) < 0 ) {
+                                    return false;
+                                }
+                                value = ( value << 4 ) | digit;
+                            }
+                            return true;
+                        };
+                        std::uint32_t codepoint;
+                        if ( !readHex( codepoint ) ) {
+                            fail();
+                            return {};
+                        }
+                        if ( codepoint >= 0xd800 && codepoint < 0xdc00 && raw.end() - it > 6 &&
+                             it[ 1 ] == '\\' && it[ 2 ] == 'u' ) {
+                            it += 2;
+                            std::uint32_t low;
+                            if ( !readHex( low ) ) {
+                                fail();
+                                return {};
+                            }
+                            codepoint = 0x10000 + ( ( codepoint - 0xd800 ) << 10 ) + ( low - 0xdc00 );
+                        }
+                        appendUtf8( result, codepoint );
+                        break;
+                    }
+                    default: result += *it; break;
+                }
+            }
+            return result;
+        }
+
+        std::string_view Reader::readRawString()
+        {
+            skipWhitespace();
+            if ( pos_ == end_ || *pos_ != '"' ) {
+                fail();
+                return {};
+            }
+            auto begin = pos_ + 1;
+            skipString();
+            return !failed_ ? std::string_view( begin, pos_ - begin - 1 ) : std::string_view();
+        }
+
+        std::intmax_t Reader::readInteger()
+        {
+            bool integral;
+            auto token = readNumberToken( integral );
+            if ( failed_ ) {
+                return 0;
+            }
+
+            char buffer[ maxNumberLength + 1 ];
+            *std::copy( token.begin(), token.end(), buffer ) = '\0';
+            return integral ? std::strtoll( buffer, nullptr, 10 ) : (std::intmax_t) std::strtod( buffer, nullptr );
+        }
+
+        std::uintmax_t Reader::readUnsigned()
+        {
+            bool integral;
+            auto token = readNumberToken( integral );
+            if ( failed_ ) {
+                return 0;
+            }
+
+            char buffer[ maxNumberLength + 1 ];
+            *std::copy( token.begin(), token.end(), buffer ) = '\0';
+            return integral ? std::strtoull( buffer, nullptr, 10 ) : (std::uintmax_t) std::strtod( buffer, nullptr );
+        }
+
+        double Reader::readDouble()
+        {
+            bool integral;
+            auto token = readNumberToken( integral );
+            if ( failed_ ) {
+                return 0.0;
+            }
+
+            char buffer[ maxNumberLength + 1 ];
+            *std::copy( token.begin(), token.end(), buffer ) = '\0';
+            return std::strtod( buffer, nullptr );
+        }
+
+        bool Reader::readBool()
+        {
+            skipWhitespace();
+            if ( end_ - pos_ >= 4 && std::strncmp( pos_, "true", 4 ) == 0 ) {
+                pos_ += 4;
+                return true;
+            }
+            if ( end_ - pos_ >= 5 && std::strncmp( pos_, "false", 5 ) == 0 ) {
+                pos_ += 5;
+                return false;
+            }
+            fail();
+            return false;
+        }
+
+        std::string_view Reader::skipValue()
+        {
+            skipWhitespace();
+            auto begin = pos_;
+            if ( pos_ == end_ ) {
+                fail();
+            }
+            else if ( *pos_ == '"' ) {
+                skipString();
+            }
+            else if ( *pos_ == '{' || *pos_ == '[' ) {
+                std::size_t depth = 0;
+                do {
+                    if ( pos_ == end_ ) {
+                        fail();
+                        break;
+                    }
+                    switch ( *pos_ ) {
+                        case '"':
+                            skipString();
+                            continue;
+                        case '{':
+                        case '[':
+                            ++depth;
+                            break;
+                        case '}':
+                        case ']':
+                            --depth;
+                            break;
+                        default:
+                            break;
+                    }
+                    ++pos_;
+                } while ( depth > 0 && !failed_ );
+            }
+            else {
+                auto token = std::find_if( pos_, end_, isDelimiter );
+                if ( token == pos_ ) {
+                    fail();
+                }
+                pos_ = token;
+            }
+            return !failed_ ? std::string_view( begin, pos_ - begin ) : std::string_view();
+        }
+
+        void Reader::skipWhitespace()
+        {
+            while ( pos_ != end_ && ( *pos_ == ' ' || *pos_ == '\t' || *pos_ == '\r' || *pos_ == '\n' ) ) {
+                ++pos_;
+            }
+        }
+
+        void Reader::skipString()
+        {
+            for ( ++pos_; pos_ != end_; ++pos_ ) {
+                if ( *pos_ == '\\' ) {
+                    if ( ++pos_ == end_ ) {
+                        break;
+                    }
+                }
+                else if ( *pos_ == '"' ) {
+                    ++pos_;
+                    return;
+                }
+            }
+            fail();
+        }
+
+        bool Reader::consume( char expected )
+        {
+            skipWhitespace();
+            if ( pos_ != end_ && *pos_ == expected ) {
+                ++pos_;
+                return true;
+            }
+            return false;
+        }
+
+        std::string_view Reader::readNumberToken( bool& integral )
+        {
+            skipWhitespace();
+            integral = true;
+            auto begin = pos_;
+            for ( ; pos_ != end_; ++pos_ ) {
+                char c = *pos_;
+                if ( c == '.' || c == 'e' || c == 'E' ) {
+                    integral = false;
+                }
+                else if ( c != '-' && c != '+' && ( c < '0' || c > '9' ) ) {
+                    break;
+                }
+            }
+            if ( pos_ == begin || pos_ - begin > (std::ptrdiff_t) maxNumberLength ) {
+                fail();
+                return {};
+            }
+            return std::string_view( begin, pos_ - begin );
+        }
+
+        void Reader::fail()
+        {
+            failed_ = true;
+            pos_ = end_;
+        }
+
+    } // namespace json
+} // namespace gcu
@@ -0,0 +1,62 @@
+#ifndef GCODEUPLOADER_JSON_READER_HPP
+#define GCODEUPLOADER_JSON_READER_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "std/string_view.hpp"
+
+namespace gcu {
+    namespace json {
+
+        // Forward-only pull reader over a JSON text that materializes only what is asked for. Malformed input
+        // sets failed() and ends all iterations.
+        class Reader
+        {
+        public:
+            enum Type
+            {
+                OBJECT,
+                ARRAY,
+                STRING,
+                NUMBER,
+                BOOLEAN,
+                NULLVALUE,
+                INVALID
+            };
+
+            explicit Reader( std::string_view text );
+
+            bool failed() const { return failed_; }
+
+            Type peek();
+
+            void beginObject();
+            bool nextMember( std::string_view& key );
+            void beginArray();
+            bool nextElement();
+
+            std::string readString();
+            std::string_view readRawString();
+            std::intmax_t readInteger();
+            std::uintmax_t readUnsigned();
+            double readDouble();
+            bool readBool();
+            std::string_view skipValue();
+
+        private:
+            void skipWhitespace();
+            void skipString();
+            bool consume( char expected );
+            std::string_view readNumberToken( bool& integral );
+            void fail();
+
+            char const* pos_;
+            char const* end_;
+            bool failed_ {};
+        };
+
+    } // namespace json
+} // namespace gcu
+
+#endif //GCODEUPLOADER_JSON_READER_HPP
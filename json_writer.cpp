@@ -0,0 +1,148 @@
+#include <cstdio>
+
+#include "json_writer.hpp"
+
+namespace gcu {
+    namespace json {
+
+        static constexpr char hexDigits[] = "0123456789abcdef";
+
+        static bool needsEscape( char c )
+        {
+            return c == '"' || c == '\\' || (unsigned char) c < 0x20;
+        }
+
+        static void appendEscaped( std::string& out, char c )
+        {
+            switch ( c ) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    out += "\\u00";
+                    out += hexDigits[ (unsigned char) c >> 4 ];
+                    out += hexDigits[ (unsigned char) c & 0xf ];
+                    break;
+            }
+        }
+
+        Writer::Writer( std::string& buffer, bool continued )
+                : buffer_( buffer )
+                , separate_( continued )
+        {
+        }
+
+        Writer& Writer::value( std::string_view value )
+        {
+            separate();
+            buffer_ += '"';
+            auto run = value.data();
+            auto end = value.data() + value.size();
+            for ( auto it = run; it != end; ++it ) {
+                if ( needsEscape( *it ) ) {
+                    buffer_.append( run, it );
+                    appendEscaped( buffer_, *it );
+                    run = it + 1;
+                }
+            }
+            buffer_.append( run, end );
+            buffer_ += '"';
+            separate_ = true;
+            return *this;
+        }
+
+        Writer& Writer::value( bool value )
+        {
+            separate();
+            buffer_ += value ? "true" : "false";
+            separate_ = true;
+            return *this;
+        }
+
+        Writer& Writer::value( double value )
+        {
+            char digits[ 32 ];
+            auto length = std::snprintf( digits, sizeof( digits ), "%.17g", value );
+            separate();
+            buffer_.append( digits, (std::size_t) length );
+            separate_ = true;
+            return *this;
+        }
+
+        Writer& Writer::beginObject()
+        {
+            separate();
+            buffer_ += '{';
+            separate_ = false;
+            return *this;
+        }
+
+        Writer& Writer::endObject()
+        {
+            buffer_ += '}';
+            separate_ = true;
+            return *this;
+        }
+
+        Writer& Writer::beginArray()
+        {
+            separate();
+            buffer_ += '[';
+            separate_ = false;
+            return *this;
+        }
+
+        Writer& Writer::endArray()
+        {
+            buffer_ += ']';
+            separate_ = true;
+            return *this;
+        }
+
+        Writer& Writer::raw( std::string_view json )
+        {
+            separate();
+            buffer_.append( json.data(), json.size() );
+            separate_ = true;
+            return *this;
+        }
+
+        void Writer::separate()
+        {
+            if ( separate_ ) {
+                buffer_ += ',';
+            }
+        }
+
+        Writer& Writer::integer( std::intmax_t value )
+        {
+            if ( value < 0 ) {
+                separate();
+                buffer_ += '-';
+                separate_ = false;
+                return unsignedInteger( 0 - (std::uintmax_t) value );
+            }
+            return unsignedInteger( (std::uintmax_t) value );
+        }
+
+        Writer& Writer::unsignedInteger( std::uintmax_t value )
+        {
+            char digits[ 24 ];
+            auto end = digits + sizeof( digits );
+            auto begin = end;
+            do {
+                *--begin = (char) ( '0' + value % 10 );
+                value /= 10;
+            } while ( value != 0 );
+            separate();
+            buffer_.append( begin, end );
+            separate_ = true;
+            return *this;
+        }
+
+    } // namespace json
+} // namespace gcu
@@ -0,0 +1,64 @@
+#ifndef GCODEUPLOADER_JSON_WRITER_HPP
+#define GCODEUPLOADER_JSON_WRITER_HPP
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+#include "std/string_view.hpp"
+
+namespace gcu {
+    namespace json {
+
+        // Appends JSON tokens to a caller-owned buffer, so a buffer that is reused keeps its capacity. Literal keys
+        // are copied verbatim, strings are escaped only where they contain characters that need it.
+        class Writer
+        {
+        public:
+            // continued writes a separator before the first token, for appending members to an open object
+            explicit Writer( std::string& buffer, bool continued = false );
+
+            template< std::size_t N >
+            Writer& key( char const ( &name )[ N ] )
+            {
+                separate();
+                buffer_ += '"';
+                buffer_.append( name, N - 1 );
+                buffer_ += "\":";
+                separate_ = false;
+                return *this;
+            }
+
+            Writer& value( std::string_view value );
+            Writer& value( char const* value ) { return this->value( std::string_view( value ) ); }
+            Writer& value( std::string const& value ) { return this->value( std::string_view( value ) ); }
+            Writer& value( bool value );
+            Writer& value( double value );
+
+            template< typename T >
+            std::enable_if_t< std::is_integral< T >::value && !std::is_same< T, bool >::value, Writer& >
+            value( T value )
+            {
+                return std::is_signed< T >::value ? integer( (std::intmax_t) value ) : unsignedInteger( value );
+            }
+
+            Writer& beginObject();
+            Writer& endObject();
+            Writer& beginArray();
+            Writer& endArray();
+            // already serialized JSON, written as the next value or as further members of an open object
+            Writer& raw( std::string_view json );
+
+        private:
+            void separate();
+            Writer& integer( std::intmax_t value );
+            Writer& unsignedInteger( std::uintmax_t value );
+
+            std::string& buffer_;
+            bool separate_;
+        };
+
+    } // namespace json
+} // namespace gcu
+
+#endif //GCODEUPLOADER_JSON_WRITER_HPP
@@ -0,0 +1,110 @@
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+
+#include "log.hpp"
+
+namespace gcu {
+    namespace log {
+
+        static constexpr std::chrono::milliseconds idleInterval( 10 );
+
+        static char const* levelName( Level level )
+        {
+            switch ( level ) {
+                case Level::debug: return "DEBUG";
+                case Level::info: return "INFO";
+                case Level::warning: return "WARN";
+                case Level::error: return "ERROR";
+            }
+            return "";
+        }
+
+        // never destroyed, io threads that outlive main() may still log; the queue is drained at exit instead
+        Logger& Logger::instance()
+        {
+            static Logger* logger = [] {
+                auto logger = new Logger;
+                std::atexit( [] { instance().stop(); } );
+                return logger;
+            }();
+            return *logger;
+        }
+
+        Logger::Logger()
+                : slots_( new Slot[ capacity ] )
+        {
+            for ( std::size_t i = 0; i < capacity; ++i ) {
+                slots_[ i ].sequence.store( i, std::memory_order_relaxed );
+            }
+            thread_ = std::thread( [this] { drain(); } );
+        }
+
+        Logger::~Logger()
+        {
+            stop();
+        }
+
+        void Logger::stop()
+        {
+            std::lock_guard< std::mutex > lock( stopMutex_ );
+            stopped_ = true;
+            if ( thread_.joinable() ) {
+                thread_.join();
+            }
+        }
+
+        Logger::Slot* Logger::acquire()
+        {
+            auto pos = enqueuePos_.load( std::memory_order_relaxed );
+            while ( true ) {
+                auto& slot = slots_[ pos % capacity ];
+                auto sequence = slot.sequence.load( std::memory_order_acquire );
+                auto diff = (std::intptr_t) sequence - (std::intptr_t) pos;
+                if ( diff == 0 ) {
+                    if ( enqueuePos_.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+                        return &slot;
+                    }
+                }
+                else if ( diff < 0 ) {
+                    dropped_.fetch_add( 1, std::memory_order_relaxed );
+                    return nullptr;
+                }
+                else {
+                    pos = enqueuePos_.load( std::memory_order_relaxed );
+                }
+            }
+        }
+
+        void Logger::publish( Slot* slot )
+        {
+            slot->sequence.store( slot->sequence.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        }
+
+        void Logger::drain()
+        {
+            while ( true ) {
+                auto& slot = slots_[ dequeuePos_ % capacity ];
+                if ( slot.sequence.load( std::memory_order_acquire ) == dequeuePos_ + 1 ) {
+                    std::cerr << levelName( slot.level ) << ": ";
+                    std::cerr.write( slot.text, slot.size ) << '\n';
+                    slot.sequence.store( dequeuePos_ + capacity, std::memory_order_release );
+                    ++dequeuePos_;
+                    continue;
+                }
+
+                auto dropped = dropped_.exchange( 0, std::memory_order_relaxed );
+                if ( dropped > 0 ) {
+                    std::cerr << "WARN: " << dropped << " log messages dropped\n";
+                }
+                std::cerr.flush();
+
+                if ( stopped_ ) {
+                    break;
+                }
+                std::this_thread::sleep_for( idleInterval );
+            }
+        }
+
+    } // namespace log
+} // namespace gcu
@@ -0,0 +1,144 @@
+#ifndef GCODEUPLOADER_LOG_HPP
+#define GCODEUPLOADER_LOG_HPP
+
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <utility>
+
+#include "std/string_view.hpp"
+
+// Messages below this level are compiled out: 0 = debug, 1 = info, 2 = warning, 3 = error
+#ifndef GCU_LOG_LEVEL
+#   ifdef NDEBUG
+#       define GCU_LOG_LEVEL 1
+#   else
+#       define GCU_LOG_LEVEL 0
+#   endif
+#endif
+
+#define GCU_LOG( level, ... ) \
+        do { \
+            if ( ::gcu::log::enabled( ::gcu::log::Level::level ) ) { \
+                ::gcu::log::Logger::instance().write( ::gcu::log::Level::level, __VA_ARGS__ ); \
+            } \
+        } while ( false )
+
+#define GCU_LOG_DEBUG( ... ) GCU_LOG( debug, __VA_ARGS__ )
+#define GCU_LOG_INFO( ... ) GCU_LOG( info, __VA_ARGS__ )
+#define GCU_LOG_WARN( ... ) GCU_LOG( warning, __VA_ARGS__ )
+#define GCU_LOG_ERROR( ... ) GCU_LOG( error, __VA_ARGS__ )
+
+namespace gcu {
+    namespace log {
+
+        enum class Level
+        {
+            debug,
+            info,
+            warning,
+            error
+        };
+
+        constexpr bool enabled( Level level )
+        {
+            return (int) level >= GCU_LOG_LEVEL;
+        }
+
+        struct Truncated
+        {
+            std::string_view text;
+            std::size_t length;
+
+            friend std::ostream& operator<<( std::ostream& os, Truncated const& value )
+            {
+                return os.write( value.text.data(), std::min( value.text.size(), value.length ) );
+            }
+        };
+
+        inline Truncated truncate( std::string_view text, std::size_t length )
+        {
+            return { text, length };
+        }
+
+        namespace detail {
+
+            class SlotBuffer
+                    : public std::streambuf
+            {
+            public:
+                void reset( char* begin, char* end ) { setp( begin, end ); }
+                std::size_t size() const { return (std::size_t) ( pptr() - pbase() ); }
+            };
+
+        } // namespace detail
+
+        // Producers format straight into a slot of a bounded lock-free ring buffer, a background thread writes the
+        // slots to std::cerr. Messages are dropped (and counted) while the ring is full, overlong ones truncated.
+        // After stop(), which runs at exit for the instance, messages are still accepted but no longer written.
+        class Logger
+        {
+            static constexpr std::size_t capacity = 1024;
+            static constexpr std::size_t slotSize = 256;
+
+            struct Slot
+            {
+                std::atomic< std::size_t > sequence;
+                Level level;
+                std::size_t size;
+                char text[ slotSize ];
+            };
+
+        public:
+            static Logger& instance();
+
+            Logger();
+            Logger( Logger const& ) = delete;
+            ~Logger();
+
+            // writes what is queued and ends the background thread
+            void stop();
+
+            template< typename ...Args >
+            void write( Level level, Args&&... args )
+            {
+                Slot* slot = acquire();
+                if ( slot == nullptr ) {
+                    return;
+                }
+
+                thread_local detail::SlotBuffer buffer;
+                thread_local std::ostream os( &buffer );
+                buffer.reset( slot->text, slot->text + slotSize );
+                os.clear();
+                int inOrder[] { ( os << std::forward< Args >( args ), 0 )... };
+                (void) inOrder;
+
+                slot->level = level;
+                slot->size = buffer.size();
+                publish( slot );
+            }
+
+        private:
+            Slot* acquire();
+            void publish( Slot* slot );
+            void drain();
+
+            std::unique_ptr< Slot[] > slots_;
+            std::atomic< std::size_t > enqueuePos_ {};
+            std::size_t dequeuePos_ {};
+            std::atomic< std::size_t > dropped_ {};
+            std::atomic< bool > stopped_ {};
+            std::mutex stopMutex_;
+            std::thread thread_;
+        };
+
+    } // namespace log
+} // namespace gcu
+
+#endif //GCODEUPLOADER_LOG_HPP
@@ -1,198 +1,591 @@
+#include <algorithm>
+#include <stdexcept>
 #include <system_error>
+#include <tuple>
+#include <utility>
 
 #include "std/filesystem.hpp"
 
+#include <asio/error.hpp>
+
+#include "http.hpp"
+#include "log.hpp"
 #include "printer_service.hpp"
+#include "repetier_error.hpp"
 
 namespace gcu {
 
-    PrinterService::PrinterService( std::string const& hostname, std::uint16_t port, std::string const& apikey )
+    PrinterService::PrinterService( std::vector< ServerConfig > servers, std::shared_ptr< Executor > executor )
+            : executor_( std::move( executor ) )
     {
-        client_.events().printersChanged.connect( [this] {
-            std::lock_guard< std::recursive_mutex > lock( mutex_ );
-            listPrinters();
-        } );
-        client_.events().modelGroupsChanged.connect( [this]( auto const& printer ) {
-            this->listModelGroups( printer );
-        } );
-        client_.events().modelsChanged.connect( [this]( auto const& printer ) {
-            this->listModels( printer );
-        } );
+        if ( servers.empty() ) {
+            throw std::invalid_argument( "at least one printer server must be configured" );
+        }
 
-        client_.connect( hostname, port, apikey, [this]( std::error_code ec ) {
-            std::lock_guard< std::recursive_mutex > lock( mutex_ );
-            if ( success( ec ) ) {
-                state_ = CONNECTED;
-                listPrinters();
+        for ( auto& config : servers ) {
+            if ( servers.size() > 1 && config.name.empty() ) {
+                throw std::invalid_argument( "printer servers must be named when more than one is configured" );
+            }
+            if ( config.name.find( '/' ) != std::string::npos ) {
+                throw std::invalid_argument( "printer server name " + config.name + " must not contain '/'" );
+            }
+            auto duplicate = std::any_of( servers_.begin(), servers_.end(), [&config]( auto const& server ) {
+                return server->config.name == config.name;
+            } );
+            if ( duplicate ) {
+                throw std::invalid_argument( "printer server name " + config.name + " is not unique" );
             }
+            servers_.push_back( std::make_unique< Server >( std::move( config ), *executor_ ) );
+        }
+
+        // connections are established in parallel, so startup is bounded by the slowest server
+        for ( auto const& ptr : servers_ ) {
+            auto& server = *ptr;
+            server.client.events().printersChanged.connect( onStrand( [this, &server] {
+                this->schedule( PRINTERS, server, {} );
+            } ) );
+            server.client.events().modelGroupsChanged.connect( onStrand( [this, &server]( auto const& printer ) {
+                this->schedule( MODEL_GROUPS, server, printer );
+            } ) );
+            server.client.events().modelsChanged.connect( onStrand( [this, &server]( auto const& printer ) {
+                this->schedule( MODELS, server, printer );
+            } ) );
+            server.client.events().linkStatsChanged.connect( [this, &server]( auto const& stats ) {
+                this->notify( linkHealthChanged, server.config.name, stats );
+            } );
+            // the printers may have changed while the connection was down, their events are lost
+            server.client.events().reconnected.connect( onStrand( [this, &server] {
+                server.state = CONNECTED;
+                this->listPrinters( server );
+            } ) );
+            server.client.events().disconnected.connect( onStrand( [this, &server]( std::error_code ec ) {
+                this->lost( server, ec );
+            } ) );
+
+            server.client.tls( server.config.tls );
+            server.client.bandwidth( bandwidth_ );
+            server.client.connect(
+                    server.config.hostname, server.config.port, server.config.apikey,
+                    onStrand( [this, &server]( std::error_code ec ) {
+                        if ( ec ) {
+                            this->lost( server, ec );
+                            return;
+                        }
+                        server.state = CONNECTED;
+                        this->listPrinters( server );
+                    } ) );
+        }
+    }
+
+    PrinterService::PrinterService( std::string const& hostname, std::uint16_t port, std::string const& apikey )
+            : PrinterService( std::vector< ServerConfig > { { {}, hostname, port, apikey } } )
+    {
+    }
+
+    PrinterService::~PrinterService()
+    {
+        work_ = std::nullopt;
+        service_.stop();
+        thread_.join();
+    }
+
+    void PrinterService::debounce( Refresh refresh, DebouncePolicy const& policy )
+    {
+        strand_.post( [this, refresh, policy] { debounce_[ refresh ] = policy; } );
+    }
+
+    void PrinterService::uploadPolicy( UploadPolicy const& policy )
+    {
+        bandwidth_->rate( policy.bandwidth, policy.burst );
+        strand_.post( [this, policy] {
+            uploadPolicy_ = policy;
+            this->startUploads();
         } );
     }
 
-    void PrinterService::requestPrinters()
+    void PrinterService::requestPrinters( CancellationToken cancellation )
     {
-        std::lock_guard< std::recursive_mutex > lock( mutex_ );
-        if ( checkConnection() && printers_ ) {
-            printersChanged( *printers_ );
-        }
+        strand_.post( [this, cancellation] {
+            if ( !cancellation.cancelled() && this->checkConnection() ) {
+                this->emitPrinters();
+            }
+        } );
     }
 
-    void PrinterService::requestModelGroups( std::string const& printer )
+    void PrinterService::requestModelGroups( std::string const& printer, CancellationToken cancellation )
     {
-        std::lock_guard< std::recursive_mutex > lock( mutex_ );
-        if ( checkConnection() ) {
+        strand_.post( [this, printer, cancellation] {
+            if ( cancellation.cancelled() || !this->checkConnection() ) {
+                return;
+            }
+
             auto it = modelGroups_.find( printer );
             if ( it != modelGroups_.end() ) {
-                modelGroupsChanged( printer, it->second );
+                this->notify( modelGroupsChanged, printer, it->second );
+                return;
             }
-        }
+
+            // most likely still waiting in the bulk lane, asking interactively coalesces with and lifts it
+            std::string slug;
+            auto server = this->resolve( printer, slug );
+            if ( server && server->state == CONNECTED ) {
+                this->listModelGroups( *server, slug, repetier::Priority::INTERACTIVE, cancellation );
+            }
+        } );
     }
 
-    void PrinterService::requestModels( std::string const& printer )
+    void PrinterService::requestModels( std::string const& printer, CancellationToken cancellation )
     {
-        std::lock_guard< std::recursive_mutex > lock( mutex_ );
-        if ( checkConnection() ) {
+        strand_.post( [this, printer, cancellation] {
+            if ( cancellation.cancelled() || !this->checkConnection() ) {
+                return;
+            }
+
             auto it = models_.find( printer );
             if ( it != models_.end() ) {
-                modelsChanged( printer, it->second );
+                this->notify( modelsChanged, printer, it->second );
+                return;
+            }
+
+            std::string slug;
+            auto server = this->resolve( printer, slug );
+            if ( server && server->state == CONNECTED ) {
+                this->listModels( *server, slug, repetier::Priority::INTERACTIVE, cancellation );
             }
+        } );
+    }
+
+    repetier::LinkStats PrinterService::linkStats( std::string const& server ) const
+    {
+        auto it = std::find_if( servers_.begin(), servers_.end(), [&server]( auto const& ptr ) {
+            return ptr->config.name == server;
+        } );
+        return it != servers_.end() ? ( *it )->client.linkStats() : repetier::LinkStats {};
+    }
+
+    Future<> PrinterService::addModelGroup( std::string const& printer, std::string const& modelGroup )
+    {
+        std::string slug;
+        auto server = resolve( printer, slug );
+        if ( !server ) {
+            return makeFailedFuture( repetier::Error::unknownPrinter );
         }
+        Promise<> promise;
+        server->client.addModelGroup( slug, modelGroup, completion( *server, promise ) );
+        return promise.future();
     }
 
-    void PrinterService::addModelGroup(
-            std::string const& printer, std::string const& modelGroup, std::function< void() > callback )
+    Future<> PrinterService::delModelGroup(
+            std::string const& printer, std::string const& modelGroup, bool deleteModels )
     {
-        client_.addModelGroup( printer, modelGroup, [this, callback = std::move( callback )]( auto ec ) {
-            std::lock_guard< std::recursive_mutex > lock( mutex_ );
-            if ( this->success( ec ) && callback ) {
-                callback();
-            }
+        std::string slug;
+        auto server = resolve( printer, slug );
+        if ( !server ) {
+            return makeFailedFuture( repetier::Error::unknownPrinter );
+        }
+        Promise<> promise;
+        server->client.delModelGroup( slug, modelGroup, deleteModels, completion( *server, promise ) );
+        return promise.future();
+    }
+
+    Future<> PrinterService::removeModel( std::string const& printer, std::size_t id )
+    {
+        std::string slug;
+        auto server = resolve( printer, slug );
+        if ( !server ) {
+            return makeFailedFuture( repetier::Error::unknownPrinter );
+        }
+        Promise<> promise;
+        server->client.removeModel( slug, id, completion( *server, promise ) );
+        return promise.future();
+    }
+
+    Future<> PrinterService::moveModelToGroup(
+            std::string const& printer, unsigned int modelId, std::string const& modelGroup )
+    {
+        std::string slug;
+        auto server = resolve( printer, slug );
+        if ( !server ) {
+            return makeFailedFuture( repetier::Error::unknownPrinter );
+        }
+        Promise<> promise;
+        server->client.moveModelFileToGroup( slug, modelId, modelGroup, completion( *server, promise ) );
+        return promise.future();
+    }
+
+    Future<> PrinterService::upload(
+            std::string const& printer, std::string const& modelName, std::string const& modelGroup,
+            std::filesystem::path const& gcodePath, repetier::Priority priority )
+    {
+        std::string slug;
+        auto server = resolve( printer, slug );
+        if ( !server ) {
+            return makeFailedFuture( repetier::Error::unknownPrinter );
+        }
+        Promise<> promise;
+        QueuedUpload queued { server, std::move( slug ), printer, modelName, modelGroup, gcodePath, priority, promise };
+        strand_.post( [this, queued = std::move( queued )]() mutable {
+            queued.backoff.policy( uploadPolicy_.retry );
+            uploads_[ (std::size_t) queued.priority ].push_back( std::move( queued ) );
+            this->startUploads();
         } );
+        return promise.future();
     }
 
-    void PrinterService::delModelGroup(
-            std::string const& printer, std::string const& modelGroup, bool deleteModels,
-            std::function< void() > callback )
+    void PrinterService::startUploads()
     {
-        client_.delModelGroup( printer, modelGroup, deleteModels, [this, callback = std::move( callback ) ]( auto ec ) {
-            std::lock_guard< std::recursive_mutex > lock( mutex_ );
-            if ( this->success( ec ) && callback ) {
-                callback();
+        for ( auto& queue : uploads_ ) {
+            // uploads towards a busy server don't hold back those towards idle ones
+            auto it = queue.begin();
+            while ( it != queue.end() && activeUploads_ < uploadPolicy_.total ) {
+                if ( it->server->uploads >= uploadPolicy_.perServer ) {
+                    ++it;
+                    continue;
+                }
+                auto queued = std::move( *it );
+                it = queue.erase( it );
+                startUpload( std::move( queued ) );
             }
-        } );
+        }
+    }
+
+    // failures of the transfer itself, as opposed to the server refusing the file, the file being unreadable or the
+    // client aborting the upload on shutdown
+    static bool retryable( std::error_code ec )
+    {
+        if ( ec.category() == http::statusCategory() ) {
+            return ec.value() >= 500;
+        }
+        return ec != repetier::Error::rejected && ec != repetier::Error::malformedResponse &&
+               ec != asio::error::operation_aborted &&
+               ec != std::errc::no_such_file_or_directory && ec != std::errc::io_error &&
+               ec != std::errc::protocol_not_supported;
     }
 
-    void PrinterService::removeModel( std::string const& printer, std::size_t id, std::function< void() > callback )
+    void PrinterService::startUpload( QueuedUpload&& queued )
     {
-        client_.removeModel( printer, id, [this, callback = std::move( callback )]( auto ec ) {
-            std::lock_guard< std::recursive_mutex > lock( mutex_ );
-            if ( this->success( ec ) && callback ) {
-                callback();
+        auto upload = std::make_shared< QueuedUpload >( std::move( queued ) );
+        auto& server = *upload->server;
+        ++server.uploads;
+        ++activeUploads_;
+
+        if ( !upload->knownModels ) {
+            auto it = models_.find( upload->printer );
+            if ( it != models_.end() ) {
+                upload->knownModels = repetier::modelIds( it->second );
+            }
+        }
+
+        auto progress = [this, printer = upload->printer, modelName = upload->modelName]( auto const& progress ) {
+            this->notify( uploadProgress, printer, modelName, progress );
+        };
+        // a failed upload is the caller's business, the connection to the server is judged by its event socket
+        auto done = onStrand( [this, &server, upload]( std::error_code ec ) {
+            --server.uploads;
+            --activeUploads_;
+            if ( ec && retryable( ec ) && !upload->backoff.exhausted() ) {
+                auto delay = upload->backoff.next();
+                GCU_LOG_WARN( "Upload of ", upload->modelName, " to ", upload->printer, " failed: ", ec.message(),
+                              ", retrying in ", delay.count(), "ms (attempt ", upload->backoff.attempts(), ")" );
+                auto timer = std::make_shared< asio::steady_timer >( service_, delay );
+                timer->async_wait( strand_.wrap( [this, timer, upload]( auto const& ec ) {
+                    if ( !ec ) {
+                        this->retryUpload( upload );
+                    }
+                } ) );
             }
+            else {
+                if ( ec ) {
+                    GCU_LOG_ERROR( "Upload of ", upload->modelName, " to ", upload->printer, " failed: ",
+                                   ec.message() );
+                }
+                service_.post( [promise = upload->promise, ec] { promise.complete( ec ); } );
+            }
+            this->startUploads();
         } );
+        server.client.upload(
+                upload->slug, upload->modelName, upload->modelGroup, upload->gcodePath, progress, std::move( done ) );
     }
 
-    void PrinterService::moveModelToGroup(
-            std::string const& printer, unsigned int modelId, std::string const& modelGroup,
-            std::function< void() > callback )
+    void PrinterService::retryUpload( std::shared_ptr< QueuedUpload > const& upload )
     {
-        client_.moveModelFileToGroup(
-                printer, modelId, modelGroup, [this, callback = std::move( callback )]( auto ec ) {
-                    std::lock_guard< std::recursive_mutex > lock( mutex_ );
-                    if ( this->success( ec ) && callback ) {
-                        callback();
+        // the connection may have dropped after the server stored the file, which must not be stored twice then
+        listModels( *upload->server, upload->slug, repetier::Priority::BACKGROUND )
+                .finally( [this, upload]( std::error_code ec ) {
+                    if ( !ec && this->arrived( *upload ) ) {
+                        GCU_LOG_INFO( "Upload of ", upload->modelName, " to ", upload->printer,
+                                      " arrived before the connection failed" );
+                        service_.post( [promise = upload->promise] { promise.setValue(); } );
+                        return;
                     }
+                    uploads_[ (std::size_t) upload->priority ].push_front( std::move( *upload ) );
+                    this->startUploads();
                 } );
     }
 
-    void PrinterService::upload(
-            std::string const& printer, std::string const& modelName, std::string const& modelGroup,
-            std::filesystem::path const& gcodePath, std::filesystem::path const& executablePath,
-            std::function< void() > callback )
-    {
-        client_.upload(
-                printer, modelName, modelGroup, gcodePath, executablePath,
-                [this, callback = std::move( callback )]( auto ec ) {
-                    std::lock_guard< std::recursive_mutex > lock( mutex_ );
-                    if ( this->success( ec ) && callback ) {
-                        callback();
-                    }
-                } );
+    // without a snapshot from before the first attempt a new model can't be told from an old one, so that upload
+    // is rather sent again than possibly skipped
+    bool PrinterService::arrived( QueuedUpload const& upload ) const
+    {
+        std::error_code ec;
+        auto size = std::filesystem::file_size( upload.gcodePath, ec );
+        auto it = models_.find( upload.printer );
+        if ( ec || it == models_.end() || !upload.knownModels ) {
+            return false;
+        }
+        return repetier::uploadArrived(
+                it->second, *upload.knownModels, upload.modelName, upload.modelGroup, (std::size_t) size );
     }
 
-    bool PrinterService::success( std::error_code ec )
+    repetier::Callback<> PrinterService::completion( Server& server, Promise<> promise )
     {
-        errorCode_ = ec;
-        if ( errorCode_ ) {
-            state_ = CLOSED;
-            connectionLost( errorCode_ );
+        return onStrand( [this, &server, promise]( std::error_code ec ) {
+            this->success( server, ec );
+            service_.post( [promise, ec] { promise.complete( ec ); } );
+        } );
+    }
+
+    PrinterService::Server* PrinterService::resolve( std::string const& printer, std::string& slug )
+    {
+        auto separator = printer.find( '/' );
+        auto name = separator != std::string::npos ? printer.substr( 0, separator ) : std::string();
+        auto it = std::find_if( servers_.begin(), servers_.end(), [&name]( auto const& server ) {
+            return server->config.name == name;
+        } );
+        if ( it == servers_.end() ) {
+            GCU_LOG_WARN( "No printer server configured for printer ", printer );
+            return nullptr;
+        }
+        slug = separator != std::string::npos ? printer.substr( separator + 1 ) : printer;
+        return it->get();
+    }
+
+    std::string PrinterService::qualify( Server const& server, std::string const& slug ) const
+    {
+        return server.config.name.empty() ? slug : server.config.name + "/" + slug;
+    }
+
+    bool PrinterService::owns( Server const& server, std::string const& printer ) const
+    {
+        if ( server.config.name.empty() ) {
+            return true;
+        }
+        return printer.size() > server.config.name.size() && printer[ server.config.name.size() ] == '/' &&
+               printer.compare( 0, server.config.name.size(), server.config.name ) == 0;
+    }
+
+    // a failed action is reported to whoever asked for it, only the client decides that the connection is gone
+    bool PrinterService::success( Server& server, std::error_code ec )
+    {
+        if ( ec ) {
+            GCU_LOG_ERROR( "Request to printer server ", server.config.hostname, " failed: ", ec.message() );
             return false;
         }
         return true;
     }
 
+    void PrinterService::lost( Server& server, std::error_code ec )
+    {
+        if ( server.state == CLOSED ) {
+            return;
+        }
+        GCU_LOG_ERROR( "Connection to printer server ", server.config.hostname, " lost: ", ec.message() );
+        errorCode_ = ec;
+        server.state = CLOSED;
+
+        // a failing server only takes down its own printers, the service is lost with the last one
+        auto lost = std::all_of( servers_.begin(), servers_.end(), []( auto const& ptr ) {
+            return ptr->state == CLOSED;
+        } );
+        if ( lost ) {
+            notify( connectionLost, errorCode_ );
+        }
+        else if ( server.printers ) {
+            server.printers = std::nullopt;
+            emitPrinters();
+        }
+    }
+
     bool PrinterService::checkConnection()
     {
-        if ( state_ == CLOSED ) {
-            connectionLost( errorCode_ );
+        auto lost = std::all_of( servers_.begin(), servers_.end(), []( auto const& ptr ) {
+            return ptr->state == CLOSED;
+        } );
+        if ( lost ) {
+            notify( connectionLost, errorCode_ );
             return false;
         }
-        return state_ == CONNECTED;
+        return std::any_of( servers_.begin(), servers_.end(), []( auto const& ptr ) {
+            return ptr->state == CONNECTED;
+        } );
     }
 
-    void PrinterService::listPrinters()
+    void PrinterService::emitPrinters()
     {
-        client_.listPrinter( [this]( std::vector< repetier::Printer > printers, std::error_code ec ) {
-            std::lock_guard< std::recursive_mutex > lock( mutex_ );
-            if ( success( ec ) ) {
-                printers_.emplace( std::move( printers ) );
-                printersChanged( *printers_ );
-                listModelsAndModelGroups();
-            }
+        auto known = std::any_of( servers_.begin(), servers_.end(), []( auto const& ptr ) {
+            return ptr->state != CLOSED && ptr->printers;
         } );
+        if ( !known ) {
+            return;
+        }
+
+        std::vector< repetier::Printer > printers;
+        for ( auto const& ptr : servers_ ) {
+            auto const& server = *ptr;
+            if ( server.state == CLOSED || !server.printers ) {
+                continue;
+            }
+            for ( auto const& printer : *server.printers ) {
+                printers.emplace_back(
+                        printer.active(),
+                        servers_.size() > 1 ? server.config.name + ": " + printer.name() : printer.name(),
+                        qualify( server, printer.slug() ) );
+            }
+        }
+        notify( printersChanged, printers );
     }
 
-    void PrinterService::listModelsAndModelGroups()
+    void PrinterService::schedule( Refresh refresh, Server& server, std::string const& slug )
     {
-        modelGroups_.clear();
-        models_.clear();
-        for ( auto const& printer : *printers_ ) {
-            listModelGroups( printer.slug() );
-            listModels( printer.slug() );
+        auto const& policy = debounce_[ refresh ];
+        if ( policy.window.count() == 0 ) {
+            this->refresh( refresh, server, slug );
+            return;
         }
+
+        auto now = std::chrono::steady_clock::now();
+        auto key = std::make_pair( refresh, qualify( server, slug ) );
+        auto it = pending_.find( key );
+        if ( it == pending_.end() ) {
+            it = pending_.emplace(
+                    std::piecewise_construct, std::forward_as_tuple( key ),
+                    std::forward_as_tuple( service_, now ) ).first;
+        }
+
+        // every event pushes the refresh out by one window, but never past the latency bound of the burst
+        auto& pending = it->second;
+        pending.deadline = std::min( now + policy.window, pending.first + policy.maxLatency );
+        pending.timer.expires_at( pending.deadline );
+        pending.timer.async_wait( strand_.wrap( [this, refresh, &server, slug, key]( auto const& ec ) {
+            if ( ec ) {
+                return;
+            }
+
+            auto it = pending_.find( key );
+            // a handler that was already queued when the deadline moved finds it in the future
+            if ( it == pending_.end() || it->second.deadline > std::chrono::steady_clock::now() ) {
+                return;
+            }
+            pending_.erase( it );
+            this->refresh( refresh, server, slug );
+        } ) );
     }
 
-    void PrinterService::listModelGroups( std::string const& printer )
+    void PrinterService::refresh( Refresh refresh, Server& server, std::string const& slug )
     {
-        client_.listModelGroups( printer, [this, printer]( auto&& modelGroups, auto ec ) {
-            std::lock_guard< std::recursive_mutex > lock( mutex_ );
-            if ( this->success( ec ) ) {
-                auto it = modelGroups_.find( printer );
-                if ( it == modelGroups_.end() ) {
-                    it = modelGroups_.emplace( printer, std::move( modelGroups ) ).first;
-                }
-                else {
-                    it->second = std::move( modelGroups );
-                }
-                modelGroupsChanged( printer, it->second );
+        switch ( refresh ) {
+            case PRINTERS:
+                listPrinters( server );
+                break;
+            case MODEL_GROUPS:
+                listModelGroups( server, slug, repetier::Priority::BACKGROUND );
+                break;
+            case MODELS:
+                listModels( server, slug, repetier::Priority::BACKGROUND );
+                break;
+        }
+    }
+
+    void PrinterService::listPrinters( Server& server )
+    {
+        server.client.listPrinter( onStrand( [this, &server]( auto&& printers, std::error_code ec ) {
+            if ( this->success( server, ec ) ) {
+                server.printers.emplace( std::move( printers ) );
+                this->emitPrinters();
+                this->listModelsAndModelGroups( server );
             }
-        } );
+        } ) );
     }
 
-    void PrinterService::listModels( std::string const& printer )
+    void PrinterService::listModelsAndModelGroups( Server& server )
     {
-        client_.listModels( printer, [this, printer]( auto&& models, auto ec ) {
-            std::lock_guard< std::recursive_mutex > lock( mutex_ );
-            if ( this->success( ec ) ) {
-                auto it = models_.find( printer );
-                if ( it == models_.end() ) {
-                    it = models_.emplace( printer, std::move( models ) ).first;
-                }
-                else {
-                    it->second = std::move( models );
-                }
-                modelsChanged( printer, it->second );
+        GCU_LOG_DEBUG( "Refreshing models and model groups of ", server.printers->size(), " printers on ",
+                       server.config.hostname );
+
+        // cached lists of printers that are still there are kept, so their refresh can be reported as a diff
+        auto erase = [this, &server]( auto& cache ) {
+            for ( auto it = cache.begin(); it != cache.end(); ) {
+                auto gone = owns( server, it->first ) && std::none_of(
+                        server.printers->begin(), server.printers->end(), [&]( auto const& printer ) {
+                            return this->qualify( server, printer.slug() ) == it->first;
+                        } );
+                it = gone ? cache.erase( it ) : std::next( it );
             }
+        };
+        erase( modelGroups_ );
+        erase( models_ );
+
+        std::vector< Future<> > lists;
+        for ( auto const& printer : *server.printers ) {
+            lists.push_back( listModelGroups( server, printer.slug(), repetier::Priority::BULK ) );
+            lists.push_back( listModels( server, printer.slug(), repetier::Priority::BULK ) );
+        }
+        whenAll( std::move( lists ) ).then( [hostname = server.config.hostname] {
+            GCU_LOG_DEBUG( "Models and model groups of all printers on ", hostname, " are up to date" );
         } );
     }
 
+    Future<> PrinterService::listModelGroups(
+            Server& server, std::string const& slug, repetier::Priority priority, CancellationToken cancellation )
+    {
+        Promise<> promise;
+        server.client.listModelGroups( slug, priority, std::move( cancellation ), onStrand(
+                [this, &server, promise, printer = qualify( server, slug )]( auto&& modelGroups, auto ec ) {
+                    if ( this->success( server, ec ) ) {
+                        auto it = modelGroups_.find( printer );
+                        if ( it == modelGroups_.end() ) {
+                            it = modelGroups_.emplace( printer, std::move( modelGroups ) ).first;
+                        }
+                        else {
+                            it->second = std::move( modelGroups );
+                        }
+                        this->notify( modelGroupsChanged, printer, it->second );
+                    }
+                    promise.complete( ec );
+                } ) );
+        return promise.future();
+    }
+
+    Future<> PrinterService::listModels(
+            Server& server, std::string const& slug, repetier::Priority priority, CancellationToken cancellation )
+    {
+        Promise<> promise;
+        server.client.listModels( slug, priority, std::move( cancellation ), onStrand(
+                [this, &server, promise, printer = qualify( server, slug )]( auto&& models, auto ec ) {
+                    if ( this->success( server, ec ) ) {
+                        this->storeModels( printer, std::move( models ) );
+                    }
+                    promise.complete( ec );
+                } ) );
+        return promise.future();
+    }
+
+    void PrinterService::storeModels( std::string const& printer, std::vector< repetier::Model > models )
+    {
+        auto it = models_.find( printer );
+        if ( it == models_.end() ) {
+            it = models_.emplace( printer, std::move( models ) ).first;
+            notify( modelsChanged, printer, it->second );
+            return;
+        }
+
+        auto diff = repetier::diffModels( it->second, models );
+        it->second = std::move( models );
+        if ( !diff.empty() ) {
+            GCU_LOG_DEBUG( "Models of ", printer, " changed: ", diff.added.size(), " added, ",
+                           diff.changed.size(), " changed, ", diff.removed.size(), " removed" );
+            notify( modelsDiffed, printer, diff );
+        }
+    }
+
 } // namespace gcu
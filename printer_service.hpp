@@ -1,21 +1,61 @@
 #ifndef GCODEUPLOADER_PRINTER_SERVICE_HPP
 #define GCODEUPLOADER_PRINTER_SERVICE_HPP
 
+#include <cstdint>
+#include <array>
+#include <chrono>
+#include <deque>
 #include <functional>
-#include <mutex>
 #include <map>
 #include <memory>
+#include <string>
 #include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "std/optional.hpp"
 
+#include <asio/io_service.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/strand.hpp>
+
 #include <boost/signals2/signal.hpp>
 
+#include "backoff.hpp"
+#include "future.hpp"
 #include "repetier.hpp"
 #include "string.hpp"
+#include "token_bucket.hpp"
 
 namespace gcu {
 
+    struct ServerConfig
+    {
+        std::string name;
+        std::string hostname;
+        std::uint16_t port;
+        std::string apikey;
+        tls::Settings tls;
+    };
+
+    struct DebouncePolicy
+    {
+        std::chrono::milliseconds window { 250 };      // quiet period that closes a burst of events, zero disables
+        std::chrono::milliseconds maxLatency { 1000 }; // longest a refresh is held back after the first event
+    };
+
+    struct UploadPolicy
+    {
+        std::size_t perServer { 2 };     // concurrent transfers towards one server
+        std::size_t total { 4 };         // concurrent transfers over all servers
+        std::uint64_t bandwidth {};      // bytes per second over all transfers, zero is unlimited
+        std::uint64_t burst { 256 * 1024 }; // taken at once after the link was idle, at least a second's worth
+        BackoffPolicy retry;                // failed transfers are queued again from the start after a delay
+    };
+
+    // Printers of all servers share one namespace: "<server>/<slug>", or just the slug for a single unnamed server.
+    // The service state is owned by a strand; signals and completion callbacks are posted outside of it.
     class PrinterService
     {
         enum State
@@ -25,49 +65,149 @@ namespace gcu {
             CLOSED
         };
 
+        struct Server
+        {
+            Server( ServerConfig config, Executor& executor ) : config( std::move( config ) ), client( executor ) {}
+
+            ServerConfig config;
+            RepetierClient client;
+            State state { CONNECTING };
+            std::optional< std::vector< repetier::Printer > > printers;
+            std::size_t uploads {};
+        };
+
+        struct QueuedUpload
+        {
+            Server* server;
+            std::string slug;
+            std::string printer;
+            std::string modelName;
+            std::string modelGroup;
+            std::filesystem::path gcodePath;
+            repetier::Priority priority;
+            Promise<> promise;
+            Backoff backoff {};
+            // ids of the printer's models before the first attempt, unknown if its models were never listed
+            std::optional< std::vector< std::size_t > > knownModels {};
+        };
+
+        struct PendingRefresh
+        {
+            PendingRefresh( asio::io_service& service, std::chrono::steady_clock::time_point first )
+                    : timer( service ), first( first ) {}
+
+            asio::steady_timer timer;
+            std::chrono::steady_clock::time_point first;
+            std::chrono::steady_clock::time_point deadline;
+        };
+
     public:
-        PrinterService( std::string const& hostname, std::uint16_t port, std::string const& apikey );
+        enum Refresh
+        {
+            PRINTERS,
+            MODEL_GROUPS,
+            MODELS
+        };
 
-        void requestPrinters();
-        void requestModelGroups( std::string const& printer );
-        void requestModels( std::string const& printer );
-
-        void addModelGroup(
-                std::string const& printer, std::string const& modelGroup, std::function< void () > callback = []{} );
-        void delModelGroup(
-                std::string const& printer, std::string const& modelGroup, bool deleteModels,
-                std::function< void () > callback = []{} );
-        void removeModel( std::string const& printer, std::size_t id, std::function< void () > callback = {} );
-        void moveModelToGroup(
-                std::string const& printer, unsigned modelId, std::string const& modelGroup,
-                std::function< void () > callback = {} );
-        void upload(
+        // connections of all servers run on the given pool; the service itself keeps one thread for its own state
+        explicit PrinterService(
+                std::vector< ServerConfig > servers,
+                std::shared_ptr< Executor > executor = std::make_shared< Executor >() );
+        PrinterService( std::string const& hostname, std::uint16_t port, std::string const& apikey );
+        PrinterService( PrinterService const& ) = delete;
+        ~PrinterService();
+
+        // server events are coalesced per printer and refresh kind before anything is fetched
+        void debounce( Refresh refresh, DebouncePolicy const& policy );
+        // uploads wait for a free slot by priority, first come first served within one
+        void uploadPolicy( UploadPolicy const& policy );
+
+        // lists not known yet are fetched right away; a cancelled request neither fetches nor notifies
+        void requestPrinters( CancellationToken cancellation = {} );
+        void requestModelGroups( std::string const& printer, CancellationToken cancellation = {} );
+        void requestModels( std::string const& printer, CancellationToken cancellation = {} );
+
+        repetier::LinkStats linkStats( std::string const& server ) const;
+
+        // the returned futures complete outside of the service strand, failures are reported to them as well
+        Future<> addModelGroup( std::string const& printer, std::string const& modelGroup );
+        Future<> delModelGroup( std::string const& printer, std::string const& modelGroup, bool deleteModels );
+        Future<> removeModel( std::string const& printer, std::size_t id );
+        Future<> moveModelToGroup( std::string const& printer, unsigned modelId, std::string const& modelGroup );
+        Future<> upload(
                 std::string const& printer, std::string const& modelName, std::string const& modelGroup,
-                std::filesystem::path const& gcodePath, std::filesystem::path const& executablePath,
-                std::function< void () > callback = {} );
+                std::filesystem::path const& gcodePath, repetier::Priority priority = repetier::Priority::INTERACTIVE );
 
         boost::signals2::signal< void ( std::error_code ) > connectionLost;
+        boost::signals2::signal< void ( std::string const&, repetier::LinkStats const& ) > linkHealthChanged;
         boost::signals2::signal< void ( std::vector< repetier::Printer > const& ) > printersChanged;
         boost::signals2::signal< void ( std::string const&, std::vector< repetier::ModelGroup > const& ) > modelGroupsChanged;
         boost::signals2::signal< void ( std::string const&, std::vector< repetier::Model > const& ) > modelsChanged;
+        // per printer and model name, throttled by the uploader
+        boost::signals2::signal< void ( std::string const&, std::string const&, repetier::UploadProgress const& ) >
+                uploadProgress;
+        // after the first full list of a printer, refreshes only report what changed
+        boost::signals2::signal< void ( std::string const&, repetier::ModelDiff const& ) > modelsDiffed;
 
     private:
-        bool success( std::error_code ec );
+        Server* resolve( std::string const& printer, std::string& slug );
+        std::string qualify( Server const& server, std::string const& slug ) const;
+        bool owns( Server const& server, std::string const& printer ) const;
 
-        bool checkConnection();
+        template< typename Handler >
+        auto onStrand( Handler handler )
+        {
+            return [this, handler]( auto&&... args ) {
+                strand_.post( std::bind( handler, std::forward< decltype( args ) >( args )... ) );
+            };
+        }
 
-        void listPrinters();
-        void listModelsAndModelGroups();
-        void listModelGroups( std::string const& printer );
-        void listModels( std::string const& printer );
+        template< typename Signal, typename ...Args >
+        void notify( Signal& signal, Args const&... args )
+        {
+            service_.post( [&signal, args...] { signal( args... ); } );
+        }
+
+        repetier::Callback<> completion( Server& server, Promise<> promise );
+        bool success( Server& server, std::error_code ec );
+        void lost( Server& server, std::error_code ec );
 
-        RepetierClient client_;
-        State state_ { CONNECTING };
+        bool checkConnection();
+        void emitPrinters();
+
+        void schedule( Refresh refresh, Server& server, std::string const& slug );
+        void refresh( Refresh refresh, Server& server, std::string const& slug );
+
+        void listPrinters( Server& server );
+        void listModelsAndModelGroups( Server& server );
+        Future<> listModelGroups(
+                Server& server, std::string const& slug, repetier::Priority priority,
+                CancellationToken cancellation = {} );
+        Future<> listModels(
+                Server& server, std::string const& slug, repetier::Priority priority,
+                CancellationToken cancellation = {} );
+        void storeModels( std::string const& printer, std::vector< repetier::Model > models );
+
+        void startUploads();
+        void startUpload( QueuedUpload&& queued );
+        void retryUpload( std::shared_ptr< QueuedUpload > const& upload );
+        bool arrived( QueuedUpload const& upload ) const;
+
+        std::shared_ptr< Executor > executor_;
+        asio::io_service service_;
+        asio::io_service::strand strand_ { service_ };
+        std::optional< asio::io_service::work > work_ { std::in_place, service_ };
+        std::vector< std::unique_ptr< Server > > servers_;
         std::error_code errorCode_;
-        std::optional< std::vector< repetier::Printer > > printers_;
         std::map< std::string, std::vector< repetier::ModelGroup > > modelGroups_;
         std::map< std::string, std::vector< repetier::Model > > models_;
-        std::recursive_mutex mutex_;
+        std::array< DebouncePolicy, 3 > debounce_ {};
+        std::map< std::pair< Refresh, std::string >, PendingRefresh > pending_;
+        UploadPolicy uploadPolicy_;
+        std::shared_ptr< TokenBucket > bandwidth_ { std::make_shared< TokenBucket >() };
+        std::array< std::deque< QueuedUpload >, repetier::priorityCount > uploads_;
+        std::size_t activeUploads_ {};
+        std::thread thread_ { [this] { service_.run(); }};
     };
 
 } // namespace gcu
@@ -1,49 +1,81 @@
-#include <cstdio>
 #include <cstdlib>
 #include <algorithm>
+#include <chrono>
 #include <functional>
 #include <iomanip>
 #include <iterator>
-#include <thread>
+#include <mutex>
 #include <utility>
 
 #include <json.hpp>
 
 #include "conversion.hpp"
-#include "http.hpp"
+#include "log.hpp"
 #include "repetier.hpp"
 #include "repetier_action.hpp"
+#include "repetier_decoder.hpp"
 #include "utf8.hpp"
 
 namespace gcu {
 
-    struct UploadUrl
+    static constexpr std::size_t pipelineDepth = 8;
+    static constexpr std::chrono::seconds pingInterval( 10 );
+    static constexpr std::chrono::seconds pongTimeout( 5 );
+
+    // connections keep themselves alive while handlers are pending, so the destructor waits for the last one to let go
+    template< typename T >
+    static std::shared_ptr< T > track( T* object, std::vector< std::future< void > >& released )
     {
-        UploadUrl( std::string const& hostname, std::uint16_t port, std::string const& printer )
-                : hostname_( hostname )
-                , port_( port )
-                , printer_( printer )
-        {
-        }
+        // one is added per upload connection, those already gone need no waiting for
+        released.erase( std::remove_if( released.begin(), released.end(), []( auto const& future ) {
+            return future.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready;
+        } ), released.end() );
 
-        template< typename Stream >
-        decltype( auto ) friend operator<<( Stream&& stream, UploadUrl const& value )
-        {
-            return stream << "http://" << value.hostname_ << ':' << value.port_ << "/printer/model/" << value.printer_;
-        }
+        auto promise = std::make_shared< std::promise< void > >();
+        released.push_back( promise->get_future() );
+        return std::shared_ptr< T >( object, [promise]( T* object ) {
+            delete object;
+            promise->set_value();
+        } );
+    }
 
-    private:
-        std::string const& hostname_;
-        std::uint16_t port_;
-        std::string const& printer_;
+    // every upload connection carries one transfer at a time and is handed to the next upload once idle
+    struct RepetierClient::Uploaders
+    {
+        std::mutex mutex;
+        bool closed {};
+        std::vector< std::shared_ptr< repetier::Uploader > > idle;
+        std::vector< std::weak_ptr< repetier::Uploader > > all;
     };
 
-    RepetierClient::RepetierClient() = default;
+    RepetierClient::RepetierClient( Executor& executor )
+            : executor_( executor )
+            , client_( track( new repetier::Client( executor.service() ), released_ ) )
+            , uploaders_( std::make_shared< Uploaders >() )
+    {
+        client_->pipeline( pipelineDepth );
+        client_->keepalive( pingInterval, pongTimeout );
+#ifdef GCU_WEBSOCKET_DEFLATE
+        repetier::CompressionSettings compression;
+        compression.enabled = true;
+        client_->compression( compression );
+#endif
+    }
 
     RepetierClient::~RepetierClient()
     {
-        client_ = std::nullopt;
-        thread_.join();
+        client_->shutdown();
+        client_.reset();
+        closeUploaders();
+
+        // the handlers that still hold on to the connections would have to run on this very thread
+        if ( executor_.inPool() ) {
+            GCU_LOG_WARN( "Printer server client released on an io thread, connections are freed in the background" );
+            return;
+        }
+        for ( auto const& released : released_ ) {
+            released.wait();
+        }
     }
 
     bool RepetierClient::connected() const
@@ -51,11 +83,43 @@ namespace gcu {
         return client_ && client_->connected();
     }
 
+    void RepetierClient::compression( repetier::CompressionSettings const& settings )
+    {
+        client_->compression( settings );
+    }
+
+    void RepetierClient::tls( gcu::tls::Settings const& settings )
+    {
+        tls_ = settings;
+#ifdef GCU_TLS
+        // uploads resume the sessions of the event connection and vice versa
+        if ( tls_.enabled && !tls_.sessions ) {
+            tls_.sessions = std::make_shared< gcu::tls::SessionCache >();
+        }
+#endif
+        client_->tls( tls_ );
+    }
+
+    void RepetierClient::bandwidth( std::shared_ptr< TokenBucket > bandwidth )
+    {
+        bandwidth_ = std::move( bandwidth );
+    }
+
+    repetier::LinkStats RepetierClient::linkStats() const
+    {
+        return client_->linkStats();
+    }
+
     repetier::ClientEvents& RepetierClient::events()
     {
         return client_->events();
     }
 
+    void RepetierClient::watchEvent( std::string type )
+    {
+        client_->watchEvent( std::move( type ) );
+    }
+
     void RepetierClient::connect(
             std::string hostname, std::uint16_t port, std::string apikey, repetier::Callback<> callback )
     {
@@ -67,84 +131,60 @@ namespace gcu {
         port_ = port;
         apikey_ = std::move( apikey );
 
+        closeUploaders();
+        uploaders_ = std::make_shared< Uploaders >();
+
         client_->connect( hostname_, port_, apikey_, std::move( callback ) );
     }
 
     void RepetierClient::listPrinter( repetier::Callback< std::vector< repetier::Printer > > callback )
     {
-        using namespace repetier::action;
-        repetier::makeAction( &*client_, "listPrinter" )
-                .handle( transform< repetier::Printer >( []( auto&& printer ) {
-                    return repetier::Printer( printer[ "active" ], printer[ "name" ], printer[ "slug" ] );
-                } ) )
+        repetier::makeAction< repetier::schema::ListPrinter >( &*client_ )
                 .send( std::move( callback ) );
     }
 
-    void RepetierClient::listModels( std::string const& printer,
-                                     repetier::Callback< std::vector< gcu::repetier::Model > > callback )
+    void RepetierClient::listModels(
+            std::string const& printer, repetier::Priority priority, CancellationToken cancellation,
+            repetier::Callback< std::vector< gcu::repetier::Model > > callback )
     {
-        using namespace repetier::action;
-        repetier::makeAction( &*client_, "listModels" )
+        repetier::makeAction< repetier::schema::ListModels >( &*client_ )
+                .priority( priority )
+                .cancellation( std::move( cancellation ) )
                 .printer( printer.c_str() )
-                .handle( resolveKey( "data" ) )
-                .handle( transform< repetier::Model >( []( auto&& model ) {
-                    return repetier::Model(
-                            model[ "id" ],
-                            model[ "name" ],
-                            model[ "group" ],
-                            model[ "created" ].template get< std::size_t >() / 1000,
-                            model[ "length" ],
-                            model[ "layer" ],
-                            model[ "lines" ],
-                            std::chrono::milliseconds(
-                                    (std::uint64_t) ( model[ "printTime" ].template get< double >() * 1000.0 ) ) );
-                } ) )
                 .send( std::move( callback ) );
     }
 
     void RepetierClient::listModelGroups(
-            std::string const& printer, repetier::Callback< std::vector< repetier::ModelGroup > > callback )
+            std::string const& printer, repetier::Priority priority, CancellationToken cancellation,
+            repetier::Callback< std::vector< repetier::ModelGroup > > callback )
     {
-        using namespace repetier::action;
-        repetier::makeAction( &*client_, "listModelGroups" )
+        repetier::makeAction< repetier::schema::ListModelGroups >( &*client_ )
+                .priority( priority )
+                .cancellation( std::move( cancellation ) )
                 .printer( printer.c_str() )
-                .handle( checkOkFlag() )
-                .handle( resolveKey( "groupNames" ) )
-                .handle( transform< repetier::ModelGroup >( []( auto&& groupName ) {
-                    return repetier::ModelGroup( groupName.template get< std::string >() );
-                } ) )
                 .send( std::move( callback ) );
     }
 
     void RepetierClient::addModelGroup(
             std::string const& printer, std::string const& modelGroup, repetier::Callback<> callback )
     {
-        using namespace repetier::action;
-        repetier::makeAction( &*client_, "addModelGroup" )
+        repetier::makeAction< repetier::schema::AddModelGroup >( &*client_, modelGroup )
                 .printer( printer.c_str() )
-                .arg( "groupName", modelGroup.c_str() )
-                .handle( checkOkFlag() )
                 .send( std::move( callback ) );
     }
 
     void RepetierClient::delModelGroup( std::string const& printer, std::string const& modelGroup, bool deleteModels,
                                         repetier::Callback<> callback )
     {
-        using namespace repetier::action;
-        repetier::makeAction( &*client_, "delModelGroup" )
+        repetier::makeAction< repetier::schema::DelModelGroup >( &*client_, modelGroup, deleteModels )
                 .printer( printer.c_str() )
-                .arg( "groupName", modelGroup.c_str() )
-                .arg( "delFiles", deleteModels )
-                .handle( checkOkFlag() )
                 .send( std::move( callback ) );
     }
 
     void RepetierClient::removeModel( std::string const& printer, std::size_t id, repetier::Callback<> callback )
     {
-        using namespace repetier::action;
-        repetier::makeAction( &*client_, "removeModel" )
+        repetier::makeAction< repetier::schema::RemoveModel >( &*client_, id )
                 .printer( printer.c_str() )
-                .arg( "id", id )
                 .send( std::move( callback ) );
     }
 
@@ -152,47 +192,73 @@ namespace gcu {
             std::string const& printer, unsigned id, std::string const& modelGroup,
             repetier::Callback<> callback )
     {
-        using namespace repetier::action;
-        repetier::makeAction( &*client_, "moveModelFileToGroup" )
+        repetier::makeAction< repetier::schema::MoveModelFileToGroup >( &*client_, modelGroup, id )
                 .printer( printer.c_str() )
-                .arg( "groupName", modelGroup.c_str() )
-                .arg( "id", id )
-                .handle( checkOkFlag() )
                 .send( std::move( callback ) );
     }
 
     void RepetierClient::upload(
             std::string const& printer, std::string const& modelName, std::string const& modelGroup,
-            std::filesystem::path const& gcodePath, std::filesystem::path const& executablePath,
+            std::filesystem::path const& gcodePath, repetier::ProgressCallback progress,
             repetier::Callback<> callback )
     {
-        std::string curlPath = (executablePath / std::filesystem::path( "curl" )).string();
-        std::string command = cnv::toString(
-                curlPath, " -s -X POST -H \"Content-Type: multipart/form-data\" -H \"x-api-key: ", apikey_, "\" ",
-                "-F \"a=upload\" -F \"name=", utf8::toUtf8( modelName ), "\" -F \"group=", utf8::toUtf8( modelGroup ),
-                "\" -F \"filename=@", gcodePath.string(), "\" ",
-                Url( url::http( port_ ), hostname_, "/printer/model/"_c, printer ) );
-
-        std::thread worker(
-                [command = std::move( command ), callback = std::move( callback )] {
-                    auto pipe = popen( command.c_str(), "r" );
-                    char buffer[ 8192 ];
-                    std::size_t count;
-                    do {
-                        count = std::fread( buffer, 1, sizeof( buffer ), pipe );
-                    } while ( count == sizeof( buffer ) );
-
-                    std::error_code ec;
-                    if ( ferror( pipe ) ) {
-                        ec = std::make_error_code( std::errc::broken_pipe ); // TODO
-                    }
-                    int status = pclose( pipe );
-                    if ( !ec && status != 0 ) {
-                        ec = std::make_error_code( std::errc::invalid_argument ); // TODO
-                    }
-                    callback( ec );
-                } );
-        worker.detach();
+        if ( hostname_.empty() ) {
+            return callback( std::make_error_code( std::errc::not_connected ) );
+        }
+
+        std::shared_ptr< repetier::Uploader > uploader;
+        {
+            std::lock_guard< std::mutex > lock( uploaders_->mutex );
+            if ( !uploaders_->idle.empty() ) {
+                uploader = std::move( uploaders_->idle.back() );
+                uploaders_->idle.pop_back();
+            }
+            else {
+                uploader = track(
+                        new repetier::Uploader( executor_.service(), hostname_, port_, apikey_, tls_, bandwidth_ ),
+                        released_ );
+                auto& all = uploaders_->all;
+                all.erase( std::remove_if( all.begin(), all.end(), []( auto const& uploader ) {
+                    return uploader.expired();
+                } ), all.end() );
+                all.push_back( uploader );
+            }
+        }
+
+        GCU_LOG_DEBUG( "Queueing upload of ", gcodePath.string(), " to printer ", printer );
+
+        auto done = [uploaders = uploaders_, uploader, callback = std::move( callback )]( std::error_code ec ) {
+            // after a failed transfer the state of the connection is unknown, the next upload opens a new one
+            if ( ec ) {
+                uploader->shutdown();
+            }
+            else {
+                std::lock_guard< std::mutex > lock( uploaders->mutex );
+                if ( !uploaders->closed ) {
+                    uploaders->idle.push_back( uploader );
+                }
+            }
+            callback( ec );
+        };
+        repetier::Upload upload {
+                printer, cnv::toString( utf8::toUtf8( modelName ) ), cnv::toString( utf8::toUtf8( modelGroup ) ),
+                gcodePath };
+        uploader->upload( std::move( upload ), std::move( progress ), std::move( done ) );
+    }
+
+    void RepetierClient::closeUploaders()
+    {
+        std::unique_lock< std::mutex > lock( uploaders_->mutex );
+        uploaders_->closed = true;
+        uploaders_->idle.clear();
+        auto all = std::move( uploaders_->all );
+        lock.unlock();
+
+        for ( auto const& uploader : all ) {
+            if ( auto alive = uploader.lock() ) {
+                alive->shutdown();
+            }
+        }
     }
 
 } // namespace gcu
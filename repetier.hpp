@@ -2,35 +2,45 @@
 #define GCODEUPLOADER_REPETIER_HPP
 
 #include <cstdint>
+#include <future>
 #include <memory>
 #include <string>
-#include <thread>
+#include <vector>
 
 #include "std/filesystem.hpp"
-#include "std/optional.hpp"
-
-#include <asio/io_service.hpp>
-
+#include "executor.hpp"
 #include "repetier_client.hpp"
 #include "repetier_definitions.hpp"
+#include "repetier_upload.hpp"
+#include "token_bucket.hpp"
 
 namespace gcu {
 
     class RepetierClient
     {
     public:
-        RepetierClient();
+        explicit RepetierClient( Executor& executor );
         RepetierClient( RepetierClient const& ) = delete;
         ~RepetierClient();
 
         bool connected() const;
+        repetier::LinkStats linkStats() const;
+        void compression( repetier::CompressionSettings const& settings );
+        void tls( gcu::tls::Settings const& settings );
+        // caps the file data of all uploads sharing the bucket
+        void bandwidth( std::shared_ptr< TokenBucket > bandwidth );
 
         repetier::ClientEvents& events();
+        void watchEvent( std::string type );
 
         void connect( std::string hostname, std::uint16_t port, std::string apikey, repetier::Callback<> callback );
         void listPrinter( repetier::Callback< std::vector< repetier::Printer > > callback );
-        void listModels( std::string const& printer, repetier::Callback< std::vector< repetier::Model > > callback );
-        void listModelGroups( std::string const& printer, repetier::Callback< std::vector< repetier::ModelGroup > > callback );
+        void listModels(
+                std::string const& printer, repetier::Priority priority, CancellationToken cancellation,
+                repetier::Callback< std::vector< repetier::Model > > callback );
+        void listModelGroups(
+                std::string const& printer, repetier::Priority priority, CancellationToken cancellation,
+                repetier::Callback< std::vector< repetier::ModelGroup > > callback );
         void addModelGroup( std::string const& printer, std::string const& modelGroup, repetier::Callback<> callback );
         void delModelGroup(
                 std::string const& printer, std::string const& modelGroup, bool deleteModels,
@@ -42,17 +52,24 @@ namespace gcu {
 
         void upload(
                 std::string const& printer, std::string const& modelName, std::string const& modelGroup,
-                std::filesystem::path const& gcodePath, std::filesystem::path const& executablePath,
+                std::filesystem::path const& gcodePath, repetier::ProgressCallback progress,
                 repetier::Callback<> callback );
 
     private:
+        struct Uploaders;
+
+        void closeUploaders();
+
+        Executor& executor_;
         std::string hostname_;
         std::uint16_t port_;
         std::string apikey_;
+        gcu::tls::Settings tls_;
+        std::shared_ptr< TokenBucket > bandwidth_;
 
-        asio::io_service service_;
-        std::optional< repetier::Client > client_ { std::in_place, service_ };
-        std::thread thread_ { [this] { service_.run(); }};
+        std::vector< std::future< void > > released_;
+        std::shared_ptr< repetier::Client > client_;
+        std::shared_ptr< Uploaders > uploaders_;
     };
 
 } // namespace gcu
@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <algorithm>
+#include <chrono>
 #include <iterator>
 #include <string>
 #include <tuple>
@@ -11,6 +12,12 @@
 
 #include <json.hpp>
 
+#include "json_reader.hpp"
+#include "json_writer.hpp"
+#include "repetier_definitions.hpp"
+#include "repetier_error.hpp"
+#include "repetier_schema.hpp"
+
 namespace gcu {
     namespace repetier {
 
@@ -57,9 +64,12 @@ namespace gcu {
             class Handled
             {
             public:
-                Handled( Client* client, nlohmann::json&& request, std::tuple< Handlers... >&& handlers )
+                Handled( Client* client, char const* name, std::string&& request, ActionOptions const& options,
+                         std::tuple< Handlers... >&& handlers )
                         : client_( client )
+                        , name_( name )
                         , request_( std::move( request ) )
+                        , options_( options )
                         , handlers_( std::move( handlers ) )
                 {
                 }
@@ -69,54 +79,134 @@ namespace gcu {
                 {
                     auto handlers = std::tuple_cat( std::move( handlers_ ), std::forward_as_tuple( handler ) );
                     return Handled< Client, Handlers..., Handler >(
-                            client_, std::move( request_ ), std::move( handlers ) );
+                            client_, name_, std::move( request_ ), options_, std::move( handlers ) );
                 }
 
                 template< typename Callback >
                 void send( Callback&& callback ) &&
                 {
                     client_->send(
-                            std::move( request_ ),
+                            name_, std::move( request_ ),
                             [callback = std::move( callback ), handlers = std::move( handlers_ ) ]
-                                    ( auto&& data, std::error_code ec ) {
-                                auto handled = invokeHandlers( std::forward< decltype( data ) >( data ), ec, handlers );
+                                    ( auto const& response, std::error_code ec ) {
+                                auto handled = invokeHandlers( !ec ? response.data() : nlohmann::json(), ec, handlers );
                                 invokeCallback( std::move( handled ), ec, callback );
-                            } );
+                            },
+                            options_ );
                 }
 
             private:
                 Client* client_;
-                nlohmann::json request_;
+                char const* name_;
+                std::string request_;
+                ActionOptions options_;
                 std::tuple< Handlers... > handlers_;
             };
 
+            template< typename Client, typename Decoder >
+            class Decoded
+            {
+            public:
+                Decoded( Client* client, char const* name, std::string&& request, ActionOptions const& options,
+                         Decoder&& decoder )
+                        : client_( client )
+                        , name_( name )
+                        , request_( std::move( request ) )
+                        , options_( options )
+                        , decoder_( std::move( decoder ) )
+                {
+                }
 
+                template< typename Callback >
+                void send( Callback&& callback ) &&
+                {
+                    client_->send(
+                            name_, std::move( request_ ),
+                            [callback = std::move( callback ), decoder = std::move( decoder_ ) ]
+                                    ( auto const& response, std::error_code ec ) {
+                                using Result = std::decay_t< decltype( decoder( std::declval< json::Reader& >(), ec ) ) >;
+                                Result result {};
+                                if ( !ec ) {
+                                    auto reader = response.reader();
+                                    result = decoder( reader, ec );
+                                }
+                                callback( std::move( result ), ec );
+                            },
+                            options_ );
+                }
+
+            private:
+                Client* client_;
+                char const* name_;
+                std::string request_;
+                ActionOptions options_;
+                Decoder decoder_;
+            };
+
+
+            // Serializes the request while it is built: the data object stays open for further args until the
+            // builder is handed to the client
             template< typename Client >
             class Action
             {
             public:
-                Action( Client* client, char const* name )
+                Action( Client* client, char const* name, ActionOptions const& options = {} )
                         : client_( client )
+                        , name_( name )
+                        , options_( options )
                 {
-                    request_[ "action" ] = name;
+                    request_ = client->requestBuffer();
+                    json::Writer( request_ ).key( "action" ).value( name ).key( "data" ).beginObject();
                 }
 
-                Action printer( char const* value ) &&
+                Action ordered() &&
+                {
+                    options_.ordered = true;
+                    return std::move( *this );
+                }
+
+                Action coalesce() &&
                 {
-                    request_[ "printer" ] = value;
+                    options_.coalesce = true;
                     return std::move( *this );
                 }
 
-                Action arg( char const* name, char const* value ) &&
+                Action idempotent() &&
                 {
-                    data_[ name ] = value;
+                    options_.idempotent = true;
                     return std::move( *this );
                 }
 
-                template< typename T >
-                Action arg( char const* name, T&& value ) &&
+                Action timeout( std::chrono::milliseconds value ) &&
                 {
-                    data_[ name ] = std::forward< T >( value );
+                    options_.timeout = value;
+                    return std::move( *this );
+                }
+
+                Action priority( Priority value ) &&
+                {
+                    options_.priority = value;
+                    return std::move( *this );
+                }
+
+                Action cancellation( CancellationToken value ) &&
+                {
+                    options_.cancellation = std::move( value );
+                    return std::move( *this );
+                }
+
+                // must outlive the builder, which is the case for the usual single-expression chains
+                Action printer( char const* value ) &&
+                {
+                    printer_ = value;
+                    return std::move( *this );
+                }
+
+                template< std::size_t N, typename T >
+                Action arg( char const ( &name )[ N ], T const& value ) &&
+                {
+                    json::Writer( request_, args_ ).key( name ).value( value );
+                    args_ = true;
                     return std::move( *this );
                 }
 
@@ -124,23 +214,118 @@ namespace gcu {
                 auto handle( Handler&& handler ) &&
                 {
                     return detail::Handled< Client, Handler >(
-                            client_, std::move( request_ ), std::forward_as_tuple( handler ) );
+                            client_, name_, finish(), options_, std::forward_as_tuple( handler ) );
+                }
+
+                template< typename Decoder >
+                auto decode( Decoder&& decoder ) &&
+                {
+                    return detail::Decoded< Client, std::decay_t< Decoder > >(
+                            client_, name_, finish(), options_, std::forward< Decoder >( decoder ) );
                 }
 
                 template< typename Callback >
                 void send( Callback&& callback )
                 {
                     client_->send(
-                            std::move( request_ ),
-                            [callback = std::move( callback ) ] ( auto&& data, std::error_code ec ) {
-                                detail::invokeCallback( std::forward< decltype( data ) >( data ), ec, callback );
-                            } );
+                            name_, finish(),
+                            [callback = std::move( callback ) ] ( auto const&, std::error_code ec ) {
+                                callback( ec );
+                            },
+                            options_ );
                 }
 
             private:
+                std::string finish()
+                {
+                    json::Writer writer( request_ );
+                    writer.endObject();
+                    if ( printer_ != nullptr ) {
+                        writer.key( "printer" ).value( printer_ );
+                    }
+                    return std::move( request_ );
+                }
+
                 Client* client_;
-                nlohmann::json request_;
-                nlohmann::json& data_ { request_[ "data" ] = nlohmann::json::object() };
+                char const* name_;
+                char const* printer_ {};
+                std::string request_;
+                bool args_ {};
+                ActionOptions options_;
+            };
+
+            template< typename Client >
+            Action< Client > writeArgs( Action< Client >&& action, schema::Fields<> )
+            {
+                return std::move( action );
+            }
+
+            template< typename Client, typename Field, typename ...Fields, typename Arg, typename ...Args >
+            Action< Client > writeArgs(
+                    Action< Client >&& action, schema::Fields< Field, Fields... >, Arg const& arg, Args const&... args )
+            {
+                static_assert( schema::Accepts< typename Field::Type, Arg >::value,
+                               "argument type does not match the action schema" );
+                return writeArgs(
+                        std::move( action ).arg( Field::key, typename Field::Type( arg ) ), schema::Fields< Fields... >(),
+                        args... );
+            }
+
+            // Addressed tells whether the printer requirement of the schema is met, so send() can check it statically
+            template< typename Client, typename Schema, bool Addressed >
+            class Typed
+            {
+            public:
+                explicit Typed( Action< Client >&& action )
+                        : action_( std::move( action ) )
+                {
+                }
+
+                Typed priority( Priority value ) &&
+                {
+                    return Typed( std::move( action_ ).priority( value ) );
+                }
+
+                Typed timeout( std::chrono::milliseconds value ) &&
+                {
+                    return Typed( std::move( action_ ).timeout( value ) );
+                }
+
+                Typed cancellation( CancellationToken value ) &&
+                {
+                    return Typed( std::move( action_ ).cancellation( std::move( value ) ) );
+                }
+
+                auto printer( char const* value ) &&
+                {
+                    static_assert( !Addressed, "action does not take a printer, or it was already given" );
+                    return Typed< Client, Schema, true >( std::move( action_ ).printer( value ) );
+                }
+
+                template< typename Callback >
+                void send( Callback&& callback ) &&
+                {
+                    static_assert( Addressed, "action needs a printer" );
+                    std::move( action_ )
+                            .decode( &Schema::decode )
+                            .send( adapt( std::forward< Callback >( callback ),
+                                          std::is_void< typename Schema::Result >() ) );
+                }
+
+            private:
+                template< typename Callback >
+                static auto adapt( Callback&& callback, std::true_type )
+                {
+                    return [callback = std::move( callback )]( auto&&, std::error_code ec ) { callback( ec ); };
+                }
+
+                template< typename Callback >
+                static Callback adapt( Callback&& callback, std::false_type )
+                {
+                    return std::forward< Callback >( callback );
+                }
+
+                Action< Client > action_;
             };
 
         } // namespace detail
@@ -151,13 +336,28 @@ namespace gcu {
             return detail::Action< Client >( client, name );
         }
 
+        // Builds an action from its schema: the arguments are the typed members of its "data" in schema order
+        template< typename Schema, typename Client, typename ...Args >
+        auto makeAction( Client* client, Args const&... args )
+        {
+            static_assert( sizeof...( Args ) == Schema::Arguments::size, "wrong number of arguments for the action" );
+
+            ActionOptions options;
+            options.ordered = Schema::ordered;
+            options.coalesce = Schema::coalesce;
+            options.idempotent = Schema::idempotent;
+            return detail::Typed< Client, Schema, !Schema::printerScoped >( detail::writeArgs(
+                    detail::Action< Client >( client, Schema::name, options ), typename Schema::Arguments(),
+                    args... ) );
+        }
+
         namespace action {
 
             inline auto checkOkFlag()
             {
                 return []( nlohmann::json&& data, std::error_code& ec ) {
                     if ( !data[ "ok" ] ) {
-                        ec = std::make_error_code( std::errc::invalid_argument ); // TODO
+                        ec = Error::rejected;
                     }
                     return std::move( data );
                 };
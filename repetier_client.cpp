@@ -1,5 +1,7 @@
+#include <cstring>
+#include <algorithm>
 #include <functional>
-#include <iostream>
+#include <iterator>
 #include <utility>
 
 #include <asio/io_service.hpp>
@@ -8,24 +10,113 @@
 #include "repetier_action.hpp"
 #include "repetier_client.hpp"
 #include "http.hpp"
+#include "json_writer.hpp"
+#include "log.hpp"
+#include "repetier_error.hpp"
 #include "utf8.hpp"
 
 namespace gcu {
     namespace repetier {
 
+        nlohmann::json Response::data() const
+        {
+            return !data_.empty() ? nlohmann::json::parse( data_.data(), data_.data() + data_.size() ) : nlohmann::json();
+        }
+
+        static constexpr std::size_t requestBufferSize = 128;
+        static constexpr std::size_t maxRequestBufferSize = 4096;
+        static constexpr std::size_t maxSpareBuffers = 32;
+
         Client::Client( asio::io_service& service )
+                : service_( service )
+                , strand_( service )
+                , deliveryStrand_( service )
+                , reconnectTimer_( service )
+                , pingTimer_( service )
         {
             wsclient_.clear_access_channels( websocketpp::log::alevel::all );
             wsclient_.clear_error_channels( websocketpp::log::elevel::all );
 
             wsclient_.init_asio( &service );
             wsclient_.start_perpetual();
+#ifdef GCU_TLS
+            wssclient_.clear_access_channels( websocketpp::log::alevel::all );
+            wssclient_.clear_error_channels( websocketpp::log::elevel::all );
+
+            wssclient_.init_asio( &service );
+            wssclient_.start_perpetual();
+#endif
+        }
+
+        template< typename Func >
+        void Client::endpoint( Func&& func )
+        {
+#ifdef GCU_TLS
+            if ( secure_ ) {
+                return func( wssclient_ );
+            }
+#endif
+            func( wsclient_ );
+        }
+
+        void Client::retry( std::size_t retryCount )
+        {
+            strand_.dispatch( [this, self = shared_from_this(), retryCount] {
+                auto policy = backoff_.policy();
+                policy.maxRetries = retryCount;
+                backoff_.policy( policy );
+            } );
+        }
+
+        void Client::reconnectPolicy( BackoffPolicy const& policy )
+        {
+            strand_.dispatch( [this, self = shared_from_this(), policy] { backoff_.policy( policy ); } );
+        }
+
+        void Client::pipeline( std::size_t depth )
+        {
+            strand_.dispatch( [this, self = shared_from_this(), depth] {
+                pipelineDepth_ = std::max< std::size_t >( depth, 1 );
+            } );
+        }
+
+        void Client::starvation( std::size_t limit )
+        {
+            strand_.dispatch( [this, self = shared_from_this(), limit] {
+                starvationLimit_ = std::max< std::size_t >( limit, 1 );
+            } );
+        }
+
+        void Client::timeout( std::chrono::milliseconds timeout )
+        {
+            strand_.dispatch( [this, self = shared_from_this(), timeout] { timeout_ = timeout; } );
+        }
+
+        void Client::keepalive( std::chrono::milliseconds interval, std::chrono::milliseconds pongTimeout )
+        {
+            strand_.dispatch( [this, self = shared_from_this(), interval, pongTimeout] {
+                pingInterval_ = interval;
+                pongTimeout_ = pongTimeout;
+                if ( status_ == CONNECTED ) {
+                    schedulePing();
+                }
+            } );
+        }
+
+        void Client::compression( CompressionSettings const& settings )
+        {
+            strand_.dispatch( [this, self = shared_from_this(), settings] { compression_ = settings; } );
         }
 
-        Client::~Client()
+        void Client::tls( gcu::tls::Settings const& settings )
         {
-            wsclient_.stop_perpetual();
-            close( false );
+            strand_.dispatch( [this, self = shared_from_this(), settings] { tls_ = settings; } );
+        }
+
+        LinkStats Client::linkStats() const
+        {
+            std::lock_guard< std::mutex > lock( statsMutex_ );
+            return publishedStats_;
         }
 
         void Client::connect(
@@ -36,193 +127,655 @@ namespace gcu {
                 throw std::invalid_argument( "connect() called on an already connected client" );
             }
 
-            hostname_ = &hostname;
-            port_ = port;
-            apikey_ = &apikey;
-            connectHandler_ = std::move( handler );
+            auto connector = [this, self = shared_from_this(), hostname, port, apikey, handler = std::move( handler )]()
+                    mutable {
+                hostname_ = hostname;
+                port_ = port;
+                apikey_ = apikey;
+                connectHandler_ = std::move( handler );
 
-            connect();
+                connect();
+            };
+            strand_.dispatch( std::move( connector ) );
         }
 
         void Client::connect()
+        {
+            secure_ = tls_.enabled;
+            if ( secure_ && !gcu::tls::supported ) {
+                GCU_LOG_ERROR( "TLS requested but not built in (GCU_TLS), refusing to connect in clear text" );
+                lose( std::make_error_code( std::errc::protocol_not_supported ) );
+                return;
+            }
+#ifdef GCU_TLS
+            if ( secure_ && !prepareTls() ) {
+                return;
+            }
+#endif
+            endpoint( [this]( auto& client ) { this->open( client ); } );
+        }
+
+        template< typename Endpoint >
+        void Client::open( Endpoint& client )
         {
             std::error_code ec;
-            auto connection =
-                    wsclient_.get_connection( cnv::toString( Url( url::ws( port_ ), *hostname_, "socket"_c ) ), ec );
+            auto uri = Url( secure_ ? url::wss( port_ ) : url::ws( port_ ), hostname_, "socket"_c );
+            auto connection = client.get_connection( cnv::toString( uri ), ec );
             if ( ec ) {
-                propagateError( ec );
+                lose( ec );
                 return;
             }
 
-            connection->set_open_handler( [this] ( auto&& ) { this->handleOpen(); } );
-            connection->set_fail_handler( [this] ( auto&& ) { this->handleFail(); } );
-            connection->set_close_handler( [this] ( auto&& ) { this->handleClose(); } );
-            connection->set_message_handler( [this] ( auto&&, auto const& message ) { this->handleMessage( message ); } );
+            connection->set_open_handler( [this, self = shared_from_this()] ( auto&& ) {
+                strand_.dispatch( [this, self = shared_from_this()] { this->handleOpen(); } );
+            } );
+            connection->set_fail_handler( [this, self = shared_from_this()] ( auto&& ) {
+                strand_.dispatch( [this, self = shared_from_this()] { this->handleFail(); } );
+            } );
+            connection->set_close_handler( [this, self = shared_from_this()] ( auto&& ) {
+                strand_.dispatch( [this, self = shared_from_this()] { this->handleClose(); } );
+            } );
+            connection->set_message_handler( [this, self = shared_from_this()] ( auto&&, auto const& message ) {
+                strand_.dispatch( [this, self = shared_from_this(), message] { this->handleMessage( message ); } );
+            } );
+            connection->set_pong_handler( [this, self = shared_from_this()] ( auto&&, auto&& ) {
+                strand_.dispatch( [this, self = shared_from_this()] { this->handlePong(); } );
+            } );
+            connection->set_pong_timeout_handler( [this, self = shared_from_this()] ( auto&&, auto&& ) {
+                strand_.dispatch( [this, self = shared_from_this()] { this->handlePongTimeout(); } );
+            } );
+            if ( pongTimeout_.count() > 0 ) {
+                connection->set_pong_timeout( (long) pongTimeout_.count() );
+            }
+            if ( compression_.enabled ) {
+#ifdef GCU_WEBSOCKET_DEFLATE
+                connection->replace_header(
+                        "Sec-WebSocket-Extensions",
+                        cnv::toString(
+                                "permessage-deflate",
+                                compression_.clientNoContextTakeover ? "; client_no_context_takeover" : "",
+                                compression_.serverNoContextTakeover ? "; server_no_context_takeover" : "",
+                                "; client_max_window_bits=", (unsigned) compression_.clientMaxWindowBits,
+                                "; server_max_window_bits=", (unsigned) compression_.serverMaxWindowBits ) );
+#else
+                GCU_LOG_WARN( "Compression requested but not built in (GCU_WEBSOCKET_DEFLATE), connecting uncompressed" );
+#endif
+            }
 
-            std::cerr << "INFO: Connecting to " << connection->get_uri()->str() << "\n";
+            GCU_LOG_INFO( "Connecting to ", connection->get_uri()->str() );
 
             status_ = CONNECTING;
             wshandle_ = connection->get_handle();
-            wsclient_.connect( connection );
+            client.connect( connection );
         }
 
-        bool Client::reconnect()
+#ifdef GCU_TLS
+        bool Client::prepareTls()
         {
-            if ( errorCount_ >= retryCount_ ) {
+            if ( !tls_.sessions ) {
+                tls_.sessions = std::make_shared< gcu::tls::SessionCache >();
+            }
+
+            std::error_code ec;
+            auto context = gcu::tls::makeContext( tls_, hostname_, ec );
+            if ( ec ) {
+                lose( ec );
                 return false;
             }
 
-            std::lock_guard< std::recursive_mutex > lock( actionMutex_ );
+            // resuming skips the certificate exchange and a round trip on every reconnect
+            wssclient_.set_tls_init_handler( [context]( websocketpp::connection_hdl ) { return context; } );
+            wssclient_.set_socket_init_handler(
+                    [sessions = tls_.sessions, peer = cnv::toString( hostname_, ':', port_ )](
+                            websocketpp::connection_hdl, auto& stream ) {
+                        sessions->resume( stream.native_handle(), peer );
+                    } );
+            return true;
+        }
+
+        void Client::reportTls()
+        {
+            auto ssl = wssclient_.get_con_from_hdl( wshandle_ )->get_raw_socket().native_handle();
+            GCU_LOG_INFO( "TLS established using ", SSL_get_version( ssl ), ", ",
+                          SSL_session_reused( ssl ) ? "session resumed" : "full handshake" );
+        }
+#endif
+
+        void Client::schedulePing()
+        {
+            if ( pingInterval_.count() == 0 ) {
+                return;
+            }
+
+            pingTimer_.expires_from_now( pingInterval_ );
+            pingTimer_.async_wait( strand_.wrap( [this, self = shared_from_this()]( auto const& ec ) {
+                if ( !ec ) {
+                    this->sendPing();
+                }
+            } ) );
+        }
 
-            std::cerr << "INFO: trying to reconnect to " << *hostname_ << ":" << port_ << "\n";
+        void Client::sendPing()
+        {
+            if ( status_ != CONNECTED ) {
+                return;
+            }
 
-            ++errorCount_;
-            if ( !actionQueue_.empty() ) {
-                actionQueue_.front().pending = false;
+            std::error_code ec;
+            pingSent_ = std::chrono::steady_clock::now();
+            endpoint( [&]( auto& client ) {
+                client.get_con_from_hdl( wshandle_ )->ping( std::to_string( linkStats_.samples ), ec );
+            } );
+            if ( ec ) {
+                GCU_LOG_WARN( "Sending ping failed: ", ec.message() );
+                schedulePing();
             }
-            status_ = CLOSED;
-            connect();
+        }
+
+        bool Client::reconnect()
+        {
+            if ( backoff_.exhausted() ) {
+                return false;
+            }
+
+            auto delay = backoff_.next();
+
+            GCU_LOG_INFO( "trying to reconnect to ", hostname_, ":", port_, " in ", delay.count(), "ms (attempt ",
+                          backoff_.attempts(), ")" );
+
+            pingTimer_.cancel();
+            replayPendingActions();
+            status_ = CONNECTING;
+            reconnectTimer_.expires_from_now( delay );
+            reconnectTimer_.async_wait( strand_.wrap( [this, self = shared_from_this()]( auto const& ec ) {
+                if ( !ec && status_ == CONNECTING ) {
+                    this->connect();
+                }
+            } ) );
 
             return true;
         }
 
+        void Client::replayPendingActions()
+        {
+            ActionList failed;
+            while ( !pendingActions_.empty() ) {
+                auto it = std::prev( pendingActions_.end() );
+                if ( it->login ) {
+                    pendingActions_.erase( it );
+                }
+                else if ( it->options.idempotent ) {
+                    // armed again when it is sent on the new connection
+                    it->deadline->cancel();
+                    auto& actions = actionQueue( it->options.priority ).actions;
+                    actions.splice( actions.begin(), pendingActions_, it );
+                }
+                else {
+                    failed.splice( failed.begin(), pendingActions_, it );
+                }
+            }
+            pendingIndex_.clear();
+            release( failed );
+            deliver( failed, Response(), std::make_error_code( std::errc::connection_aborted ) );
+        }
+
         void Client::close()
         {
-            close( true );
+            if ( status_ != CONNECTING && status_ != CONNECTED ) {
+                throw std::invalid_argument( "close() called on already closed (or closing) client" );
+            }
+            strand_.dispatch( [this, self = shared_from_this()] { disconnect(); } );
+        }
+
+        void Client::shutdown()
+        {
+            strand_.dispatch( [this, self = shared_from_this()] {
+                wsclient_.stop_perpetual();
+#ifdef GCU_TLS
+                wssclient_.stop_perpetual();
+#endif
+                connectHandler_ = nullptr;
+
+                ActionList actions;
+                actions.splice( actions.end(), pendingActions_ );
+                std::for_each( actionQueues_.begin(), actionQueues_.end(), [&]( auto& queue ) {
+                    actions.splice( actions.end(), queue.actions );
+                } );
+                pendingIndex_.clear();
+                coalescingIndex_.clear();
+
+                disconnect();
+            } );
         }
 
         void Client::handleOpen()
         {
-            std::cerr << "INFO: Connection established, logging in\n";
+            GCU_LOG_INFO( "Connection established, logging in" );
+#ifdef GCU_TLS
+            if ( secure_ ) {
+                reportTls();
+            }
+#endif
 
-            makeAction( this, "login" )
-                    .arg( "apikey", apikey_->c_str() )
-                    .handle( action::checkOkFlag() )
-                    .send( [this]( std::error_code ec ) {
-                        if ( ec ) {
-                            std::cerr << "ERROR: Login failed, closing connection\n";
-                            close();
-                        }
-                        else {
-                            std::cerr << "INFO: Login successful, connection ready\n";
-                            status_ = CONNECTED;
-                            errorCount_ = 0;
-                        }
-                        if ( connectHandler_ ) {
-                            connectHandler_( ec );
-                            connectHandler_ = nullptr;
-                        }
+            makeAction< schema::Login >( this, apikey_ )
+                    .send( [this, self = shared_from_this()]( std::error_code ec ) {
+                        strand_.dispatch( [this, self = shared_from_this(), ec] { this->handleLogin( ec ); } );
                     } );
         }
 
+        void Client::handleLogin( std::error_code ec )
+        {
+            if ( ec ) {
+                GCU_LOG_ERROR( "Login failed, closing connection" );
+                disconnect();
+                // a reconnect has no handler waiting for it
+                if ( !connectHandler_ ) {
+                    deliveryStrand_.post( [this, self = shared_from_this(), ec] { events_.disconnected( ec ); } );
+                }
+            }
+            else {
+                GCU_LOG_INFO( "Login successful, connection ready" );
+                status_ = CONNECTED;
+                backoff_.reset();
+                schedulePing();
+                sendIfReady();
+                if ( !connectHandler_ ) {
+                    deliveryStrand_.post( [this, self = shared_from_this()] { events_.reconnected(); } );
+                }
+            }
+            if ( connectHandler_ ) {
+                deliveryStrand_.post( std::bind( std::move( connectHandler_ ), ec ) );
+                connectHandler_ = nullptr;
+            }
+        }
+
         void Client::handleFail()
         {
-            auto connection = wsclient_.get_con_from_hdl( wshandle_ );
+            std::error_code ec;
+            endpoint( [&]( auto& client ) { ec = client.get_con_from_hdl( wshandle_ )->get_ec(); } );
 
-            std::cerr << "ERROR: Connection failed: " << connection->get_ec() << "\n";
+            GCU_LOG_ERROR( "Connection failed: ", ec );
 
             if ( !reconnect() ) {
-                propagateError( connection->get_ec() );
+                lose( ec );
             }
         }
 
         void Client::handleClose()
         {
-            auto connection = wsclient_.get_con_from_hdl( wshandle_ );
             if ( status_ != CLOSING ) {
-                std::cerr << "ERROR: Connection closed by server: code "
-                          << websocketpp::close::status::get_string( connection->get_remote_close_code())
-                          << ", reason: " << connection->get_remote_close_reason() << "\n";
+                endpoint( [&]( auto& client ) {
+                    auto connection = client.get_con_from_hdl( wshandle_ );
+                    GCU_LOG_ERROR( "Connection closed by server: code ",
+                                   websocketpp::close::status::get_string( connection->get_remote_close_code() ),
+                                   ", reason: ", connection->get_remote_close_reason() );
+                } );
 
-                if ( reconnect() ) {
-                    return;
+                if ( !reconnect() ) {
+                    lose( Error::connectionClosed );
                 }
+                return;
             }
             status_ = CLOSED;
-            propagateError( std::make_error_code( std::errc::invalid_argument ) ); // TODO
+            propagateError( Error::connectionClosed );
         }
 
         void Client::handleMessage( websocketclient::message_ptr message )
         {
-            std::cerr << "<<< " << message->get_payload().substr( 0, 80 ) << "\n";
+            auto const& payload = message->get_payload();
+
+            GCU_LOG_DEBUG( "<<< ", log::truncate( payload, 80 ) );
 
-            auto response = nlohmann::json::parse( message->get_payload() );
-            auto callbackId = response[ "callback_id" ];
-            if ( callbackId != -1 ) {
-                handleActionResponse( callbackId, std::move( response ) );
+            std::intmax_t callbackId = -1;
+            bool eventList = false;
+            std::string_view data;
+
+            json::Reader reader( payload );
+            std::string_view key;
+            reader.beginObject();
+            while ( reader.nextMember( key ) ) {
+                if ( key == "callback_id" ) {
+                    callbackId = reader.readInteger();
+                }
+                else if ( key == "eventList" ) {
+                    eventList = reader.readBool();
+                }
+                else if ( key == "data" ) {
+                    data = reader.skipValue();
+                }
+                else {
+                    reader.skipValue();
+                }
             }
-            else if ( response[ "eventList" ] ) {
-                auto& eventList = response[ "data" ];
-                std::for_each( eventList.begin(), eventList.end(), [this]( auto&& event ) {
-                    this->handleEvent( std::move( event ) );
-                } );
+
+            if ( reader.failed() ) {
+                GCU_LOG_WARN( "Malformed message, ignoring" );
+            }
+            else if ( callbackId != -1 ) {
+                handleActionResponse( callbackId, Response( data, message ) );
+            }
+            else if ( eventList ) {
+                handleEvents( data );
             }
             else {
-                std::cerr << "WARN: Unknown response (neither callback nor events)\n";
+                GCU_LOG_WARN( "Unknown response (neither callback nor events)" );
+            }
+        }
+
+        void Client::handleActionResponse( std::intmax_t callbackId, Response const& response )
+        {
+            auto it = pendingIndex_.find( callbackId );
+            if ( it != pendingIndex_.end() ) {
+                ActionList completed;
+                completed.splice( completed.end(), pendingActions_, it->second );
+                pendingIndex_.erase( it );
+                release( completed );
+                deliver( completed, response, {} );
+                return sendIfReady();
             }
+
+            GCU_LOG_WARN( "Received response to unrequested callback ", callbackId, ", ignoring message" );
+        }
+
+        void Client::handleEvents( std::string_view events )
+        {
+            json::Reader reader( events );
+            reader.beginArray();
+            while ( reader.nextElement() ) {
+                std::string_view key;
+                std::string_view type;
+                std::string_view printer;
+                reader.beginObject();
+                while ( reader.nextMember( key ) ) {
+                    if ( key == "event" ) {
+                        type = reader.readRawString();
+                    }
+                    else if ( key == "printer" ) {
+                        printer = reader.skipValue();
+                    }
+                    else {
+                        reader.skipValue();
+                    }
+                }
+
+                auto watched = std::find( watchedEvents_.begin(), watchedEvents_.end(), type );
+                if ( !reader.failed() && watched != watchedEvents_.end() ) {
+                    handleEvent( type, printer.empty() ? std::string() : json::Reader( printer ).readString() );
+                }
+            }
+
+            if ( reader.failed() ) {
+                GCU_LOG_WARN( "Malformed event list, ignoring remaining events" );
+            }
+        }
+
+        void Client::handleEvent( std::string_view type, std::string const& printer )
+        {
+            std::string name( type.data(), type.size() );
+            deliveryStrand_.post( [this, self = shared_from_this(), type = std::move( name ), printer] {
+                if ( type == "printerListChanged" ) {
+                    events_.printersChanged();
+                }
+                else if ( type == "modelGroupListChanged" ) {
+                    events_.modelGroupsChanged( printer );
+                }
+                else if ( type == "jobsChanged" ) {
+                    events_.modelsChanged( printer );
+                }
+                events_.eventReceived( type, printer );
+            } );
+        }
+
+        void Client::handlePong()
+        {
+            auto rtt = std::chrono::duration_cast< std::chrono::microseconds >(
+                    std::chrono::steady_clock::now() - pingSent_ );
+            rttSamples_[ linkStats_.samples++ % rttSamples_.size() ] = rtt;
+
+            decltype( rttSamples_ ) sorted;
+            auto count = std::min( linkStats_.samples, rttSamples_.size() );
+            std::copy_n( rttSamples_.begin(), count, sorted.begin() );
+            std::sort( sorted.begin(), sorted.begin() + count );
+
+            linkStats_.last = rtt;
+            linkStats_.average = linkStats_.samples == 1 ? rtt : ( linkStats_.average * 4 + rtt ) / 5;
+            linkStats_.p50 = sorted[ count * 50 / 100 ];
+            linkStats_.p95 = sorted[ count * 95 / 100 ];
+            linkStats_.p99 = sorted[ count * 99 / 100 ];
+
+            schedulePing();
+            publish( linkStats_ );
         }
 
-        void Client::handleActionResponse( std::intmax_t callbackId, nlohmann::json&& response )
+        void Client::handlePongTimeout()
         {
-            std::lock_guard< std::recursive_mutex > lock( actionMutex_ );
+            GCU_LOG_WARN( "No pong from ", hostname_, ":", port_, " within ", pongTimeout_.count(),
+                          "ms, dropping connection" );
+
+            ++linkStats_.missedPongs;
+
+            std::error_code ec;
+            endpoint( [&]( auto& client ) {
+                client.close( wshandle_, websocketpp::close::status::going_away, "pong timeout", ec );
+            } );
+            publish( linkStats_ );
+        }
 
-            if ( !actionQueue_.empty() ) {
-                auto& action = actionQueue_.front();
-                if ( action.pending && action.callbackId == callbackId ) {
-                    action.handler( std::move( response[ "data" ] ), {} );
-                    actionQueue_.pop_front();
-                    return sendIfReady();
+        void Client::watchEvent( std::string type )
+        {
+            strand_.dispatch( [this, self = shared_from_this(), type = std::move( type )] {
+                if ( std::find( watchedEvents_.begin(), watchedEvents_.end(), type ) == watchedEvents_.end() ) {
+                    watchedEvents_.push_back( type );
                 }
+            } );
+        }
+
+        void Client::send(
+                char const* name, std::string&& request, ActionHandler&& handler, ActionOptions const& options )
+        {
+            strand_.dispatch(
+                    [this, self = shared_from_this(), name, request = std::move( request ),
+                     handler = std::move( handler ), options]() mutable {
+                        this->enqueue( name, std::move( request ), std::move( handler ), options );
+                    } );
+        }
+
+        void Client::enqueue(
+                char const* name, std::string&& request, ActionHandler&& handler, ActionOptions const& options )
+        {
+            if ( options.coalesce && coalesce( request, std::move( handler ), options ) ) {
+                recycle( std::move( request ) );
+                return;
             }
 
-            std::cerr << "WARN: Received response to unrequested callback " << callbackId << ", ignoring message\n";
+            bool login = std::strcmp( name, "login" ) == 0;
+            auto& actions = actionQueue( login ? Priority::INTERACTIVE : options.priority ).actions;
+            auto it = actions.emplace(
+                    login ? actions.begin() : actions.end(),
+                    ++nextCallbackId_, name, std::move( request ), std::move( handler ), options );
+            it->login = login;
+            if ( options.coalesce ) {
+                coalescingIndex_.emplace( it->request, it );
+            }
+            sendIfReady();
         }
 
-        void Client::handleEvent( nlohmann::json&& event )
+        std::string Client::requestBuffer()
         {
-            auto type = event[ "event" ];
-            if ( type == "printerListChanged" ) {
-                events_.printersChanged();
+            std::lock_guard< std::mutex > lock( buffersMutex_ );
+            if ( spareBuffers_.empty() ) {
+                std::string buffer;
+                buffer.reserve( requestBufferSize );
+                return buffer;
             }
-            else if ( type == "modelGroupListChanged" ) {
-                events_.modelGroupsChanged( event[ "printer" ] );
+            auto buffer = std::move( spareBuffers_.back() );
+            spareBuffers_.pop_back();
+            return buffer;
+        }
+
+        void Client::recycle( std::string&& buffer )
+        {
+            // an unusually large request doesn't pin its memory
+            if ( buffer.capacity() > maxRequestBufferSize ) {
+                return;
             }
-            else if ( type == "jobsChanged" ) {
-                events_.modelsChanged( event[ "printer" ] );
+            std::lock_guard< std::mutex > lock( buffersMutex_ );
+            if ( spareBuffers_.size() < maxSpareBuffers ) {
+                buffer.clear();
+                spareBuffers_.push_back( std::move( buffer ) );
             }
         }
 
-        void Client::send( nlohmann::json&& request, ActionHandler&& handler )
+        bool Client::coalesce( std::string const& request, ActionHandler&& handler, ActionOptions const& options )
         {
-            std::lock_guard< std::recursive_mutex > lock( actionMutex_ );
+            auto it = coalescingIndex_.find( request );
+            if ( it == coalescingIndex_.end() ) {
+                return false;
+            }
 
-            auto it = request[ "action" ] == "login" ? actionQueue_.begin() : actionQueue_.end();
-            actionQueue_.emplace( it, ++nextCallbackId_, std::move( request ), std::move( handler ) );
-            sendIfReady();
+            auto action = it->second;
+            action->waiters.push_back( { std::move( handler ), options.cancellation } );
+
+            auto priority = options.priority;
+            // a more urgent caller lifts a still queued action into its own lane
+            if ( priority < action->options.priority && pendingIndex_.count( action->callbackId ) == 0 ) {
+                auto& from = actionQueue( action->options.priority ).actions;
+                auto& to = actionQueue( priority ).actions;
+                to.splice( to.end(), from, action );
+                action->options.priority = priority;
+            }
+            return true;
         }
 
-        void Client::sendIfReady()
+        void Client::dropCancelled()
+        {
+            for ( auto& queue : actionQueues_ ) {
+                for ( auto it = queue.actions.begin(); it != queue.actions.end(); ) {
+                    if ( it->login || !it->cancelled() ) {
+                        ++it;
+                        continue;
+                    }
+
+                    GCU_LOG_DEBUG( "Action ", it->name, " (callback ", it->callbackId, ") cancelled before sending" );
+                    if ( it->options.coalesce ) {
+                        coalescingIndex_.erase( it->request );
+                    }
+                    recycle( std::move( it->request ) );
+                    it = queue.actions.erase( it );
+                }
+            }
+        }
+
+        // the actions are done with their requests, only their waiters are left to be answered
+        void Client::release( ActionList& actions )
+        {
+            std::for_each( actions.begin(), actions.end(), [this]( auto& action ) {
+                if ( action.options.coalesce ) {
+                    coalescingIndex_.erase( action.request );
+                }
+                this->recycle( std::move( action.request ) );
+            } );
+        }
+
+        Client::ActionQueue* Client::nextActionQueue()
         {
-            if ( !actionQueue_.empty() ) {
-                auto& action = actionQueue_.front();
-                if ( !action.pending ) {
-                    auto payload = action.request.dump();
+            if ( status_ != CONNECTED ) {
+                auto& queue = actionQueue( Priority::INTERACTIVE );
+                return !queue.actions.empty() && queue.actions.front().login ? &queue : nullptr;
+            }
 
-                    std::cerr << ">>> " << payload.substr( 0, 80 ) << "\n";
+            auto starved = std::find_if( actionQueues_.rbegin(), actionQueues_.rend(), [this]( auto const& queue ) {
+                return !queue.actions.empty() && queue.passedOver >= starvationLimit_;
+            } );
+            if ( starved != actionQueues_.rend() ) {
+                return &*starved;
+            }
 
-                    auto connection = wsclient_.get_con_from_hdl( wshandle_ );
-                    connection->send( payload, websocketpp::frame::opcode::text );
+            auto next = std::find_if( actionQueues_.begin(), actionQueues_.end(), []( auto const& queue ) {
+                return !queue.actions.empty();
+            } );
+            return next != actionQueues_.end() ? &*next : nullptr;
+        }
 
-                    action.pending = true;
+        // the deadline runs from sending, time spent queued or waiting out a reconnect does not count
+        void Client::arm( Action& action )
+        {
+            if ( !action.deadline ) {
+                action.deadline = std::make_unique< asio::steady_timer >( service_ );
+            }
+            action.deadline->expires_from_now(
+                    action.options.timeout.count() > 0 ? action.options.timeout : timeout_ );
+            auto callbackId = action.callbackId;
+            action.deadline->async_wait( strand_.wrap( [this, self = shared_from_this(), callbackId]( auto const& ec ) {
+                if ( !ec ) {
+                    this->expire( callbackId );
                 }
+            } ) );
+        }
+
+        void Client::expire( std::intmax_t callbackId )
+        {
+            auto pending = pendingIndex_.find( callbackId );
+            // a handler that was already queued when a replayed action got armed again finds the deadline moved
+            if ( pending == pendingIndex_.end() ||
+                 pending->second->deadline->expires_at() > std::chrono::steady_clock::now() ) {
+                return;
             }
+
+            ActionList expired;
+            expired.splice( expired.end(), pendingActions_, pending->second );
+            pendingIndex_.erase( pending );
+
+            GCU_LOG_WARN( "Action ", expired.front().name, " (callback ",
+                          callbackId, ") timed out" );
+
+            release( expired );
+            deliver( expired, Response(), Error::timedOut );
+            sendIfReady();
         }
 
-        void Client::close( bool checked )
+        bool Client::readyToSend( Action const& action ) const
         {
-            if ( checked && status_ != CONNECTING && status_ != CONNECTED ) {
-                throw std::invalid_argument( "close() called on already closed (or closing) client" );
+            if ( pendingActions_.empty() ) {
+                return true;
+            }
+            return pendingActions_.size() < pipelineDepth_ &&
+                   !action.options.ordered && !pendingActions_.front().options.ordered;
+        }
+
+        void Client::sendIfReady()
+        {
+            dropCancelled();
+
+            ActionQueue* queue;
+            while ( ( queue = nextActionQueue() ) != nullptr && readyToSend( queue->actions.front() ) ) {
+                auto it = queue->actions.begin();
+
+                sendBuffer_.clear();
+                json::Writer( sendBuffer_ ).beginObject().key( "callback_id" ).value( it->callbackId )
+                        .raw( it->request ).endObject();
+
+                GCU_LOG_DEBUG( ">>> ", log::truncate( sendBuffer_, 80 ) );
+
+                endpoint( [&]( auto& client ) {
+                    client.get_con_from_hdl( wshandle_ )->send( sendBuffer_, websocketpp::frame::opcode::text );
+                } );
+
+                pendingActions_.splice( pendingActions_.end(), queue->actions, it );
+                pendingIndex_.emplace( it->callbackId, it );
+                arm( *it );
+
+                queue->passedOver = 0;
+                std::for_each( queue + 1, actionQueues_.data() + actionQueues_.size(), []( auto& lower ) {
+                    if ( !lower.actions.empty() ) {
+                        ++lower.passedOver;
+                    }
+                } );
             }
+        }
+
+        void Client::disconnect()
+        {
             if ( status_ == CLOSED ) {
                 return;
             }
@@ -231,11 +784,13 @@ namespace gcu {
                 return forceClose();
             }
             status_ = CLOSING;
+            reconnectTimer_.cancel();
+            pingTimer_.cancel();
 
             std::error_code ec;
-            wsclient_.close( wshandle_, websocketpp::close::status::normal, {}, ec );
+            endpoint( [&]( auto& client ) { client.close( wshandle_, websocketpp::close::status::normal, {}, ec ); } );
             if ( ec ) {
-                std::cerr << "WARN: Closing connection normally failed, close forced: " << ec.message() << "\n";
+                GCU_LOG_WARN( "Closing connection normally failed, close forced: ", ec.message() );
                 forceClose();
             }
         }
@@ -245,21 +800,66 @@ namespace gcu {
             status_ = CLOSED;
 
             std::error_code ec;
-            wsclient_.close( wshandle_, websocketpp::close::status::force_tcp_drop, {}, ec );
+            endpoint( [&]( auto& client ) {
+                client.close( wshandle_, websocketpp::close::status::force_tcp_drop, {}, ec );
+            } );
         }
 
-        void Client::propagateError( std::error_code ec )
+        void Client::deliver( ActionList& actions, Response const& response, std::error_code ec )
         {
-            std::lock_guard< std::recursive_mutex > lock( actionMutex_ );
+            std::for_each( actions.begin(), actions.end(), [&]( auto& action ) {
+                if ( action.cancelled() ) {
+                    return;
+                }
 
+                // cancellation is checked again right before each handler, which is where decoding happens
+                auto waiters = std::move( action.waiters );
+                deliveryStrand_.post( [self = shared_from_this(), waiters = std::move( waiters ), response, ec] {
+                    std::for_each( waiters.begin(), waiters.end(), [&]( auto const& waiter ) {
+                        if ( !waiter.cancellation.cancelled() ) {
+                            waiter.handler( response, ec );
+                        }
+                    } );
+                } );
+            } );
+        }
+
+        void Client::publish( LinkStats const& stats )
+        {
+            {
+                std::lock_guard< std::mutex > lock( statsMutex_ );
+                publishedStats_ = stats;
+            }
+            deliveryStrand_.post( [this, self = shared_from_this(), stats] { events_.linkStatsChanged( stats ); } );
+        }
+
+        // the connection is gone for good, the owner hears of it unless it still waits for connect() to finish
+        void Client::lose( std::error_code ec )
+        {
+            status_ = CLOSED;
+            pingTimer_.cancel();
+            if ( !connectHandler_ ) {
+                deliveryStrand_.post( [this, self = shared_from_this(), ec] { events_.disconnected( ec ); } );
+            }
+            propagateError( ec );
+        }
+
+        void Client::propagateError( std::error_code ec )
+        {
             if ( connectHandler_ ) {
-                connectHandler_( ec );
+                deliveryStrand_.post( std::bind( std::move( connectHandler_ ), ec ) );
+                connectHandler_ = nullptr;
             }
 
-            std::for_each( actionQueue_.begin(), actionQueue_.end(), [&]( auto& action ) {
-                action.handler( {}, ec );
+            ActionList actions;
+            actions.splice( actions.end(), pendingActions_ );
+            std::for_each( actionQueues_.begin(), actionQueues_.end(), [&]( auto& queue ) {
+                actions.splice( actions.end(), queue.actions );
+                queue.passedOver = 0;
             } );
-            actionQueue_.clear();
+            pendingIndex_.clear();
+            release( actions );
+            deliver( actions, Response(), ec );
         }
 
     } // namespace repetier
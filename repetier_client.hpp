@@ -2,42 +2,149 @@
 #define GCODEUPLOADER_REPETIER_CLIENT_HPP
 
 #include <cstdint>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include <asio/io_service.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/strand.hpp>
 
 #include <boost/signals2/signal.hpp>
 
 #include <json.hpp>
 
 #include <websocketpp/config/asio_no_tls_client.hpp>
+#ifdef GCU_TLS
+#   include <websocketpp/config/asio_client.hpp>
+#endif
 #include <websocketpp/client.hpp>
+#ifdef GCU_WEBSOCKET_DEFLATE
+#   include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+#endif
 
 #include "std/optional.hpp"
+#include "std/string_view.hpp"
 
+#include "backoff.hpp"
+#include "json_reader.hpp"
 #include "repetier_definitions.hpp"
+#include "tls.hpp"
 
 namespace gcu {
     namespace repetier {
 
+        namespace detail {
+
+#ifdef GCU_WEBSOCKET_DEFLATE
+            template< typename Base >
+            struct Compressed
+                    : Base
+            {
+                using type = Compressed;
+                using base = Base;
+
+                using concurrency_type = typename base::concurrency_type;
+                using request_type = typename base::request_type;
+                using response_type = typename base::response_type;
+                using message_type = typename base::message_type;
+                using con_msg_manager_type = typename base::con_msg_manager_type;
+                using endpoint_msg_manager_type = typename base::endpoint_msg_manager_type;
+                using alog_type = typename base::alog_type;
+                using elog_type = typename base::elog_type;
+                using rng_type = typename base::rng_type;
+                using transport_type = typename base::transport_type;
+
+                struct permessage_deflate_config {};
+                using permessage_deflate_type =
+                        websocketpp::extensions::permessage_deflate::enabled< permessage_deflate_config >;
+            };
+
+            using ClientConfig = Compressed< websocketpp::config::asio_client >;
+#   ifdef GCU_TLS
+            using SecureClientConfig = Compressed< websocketpp::config::asio_tls_client >;
+#   endif
+#else
+            using ClientConfig = websocketpp::config::asio_client;
+#   ifdef GCU_TLS
+            using SecureClientConfig = websocketpp::config::asio_tls_client;
+#   endif
+#endif
+
+        } // namespace detail
+
+        // Offered to the server as permessage-deflate parameters; only honoured in builds with GCU_WEBSOCKET_DEFLATE
+        struct CompressionSettings
+        {
+            bool enabled {};
+            bool clientNoContextTakeover {};
+            bool serverNoContextTakeover {};
+            std::uint8_t clientMaxWindowBits { 15 };
+            std::uint8_t serverMaxWindowBits { 15 };
+        };
+
+        class Response
+        {
+        public:
+            Response() = default;
+            Response( std::string_view data, std::shared_ptr< void const > owner )
+                    : data_( data ), owner_( std::move( owner ) ) {}
+
+            nlohmann::json data() const;
+            json::Reader reader() const { return json::Reader( data_ ); }
+
+        private:
+            std::string_view data_;
+            // keeps the received message alive while handlers run outside the strand
+            std::shared_ptr< void const > owner_;
+        };
+
+        struct LinkStats
+        {
+            std::chrono::microseconds last {};
+            std::chrono::microseconds average {};
+            std::chrono::microseconds p50 {};
+            std::chrono::microseconds p95 {};
+            std::chrono::microseconds p99 {};
+            std::size_t samples {};
+            std::size_t missedPongs {};
+        };
+
         struct ClientEvents
         {
             boost::signals2::signal< void () > printersChanged;
             boost::signals2::signal< void ( std::string const& printer ) > modelGroupsChanged;
             boost::signals2::signal< void ( std::string const& printer ) > modelsChanged;
+            boost::signals2::signal< void ( std::string const& event, std::string const& printer ) > eventReceived;
+            boost::signals2::signal< void ( LinkStats const& stats ) > linkStatsChanged;
+            // logged in again after the connection dropped, events may have been missed meanwhile
+            boost::signals2::signal< void () > reconnected;
+            // the client gave up on an established connection, a failing connect() is reported to its handler instead
+            boost::signals2::signal< void ( std::error_code ec ) > disconnected;
         };
 
+        // All connection and queue state is owned by a strand; public calls are posted to it, while events and
+        // action handlers are delivered in order on a second strand outside of it. Pending handlers keep the client
+        // alive, so it must be owned by a shared_ptr and shut down before it is released.
         class Client
+                : public std::enable_shared_from_this< Client >
         {
-            using websocketclient = websocketpp::client< websocketpp::config::asio_client >;
+            using websocketclient = websocketpp::client< detail::ClientConfig >;
+#ifdef GCU_TLS
+            using securewebsocketclient = websocketpp::client< detail::SecureClientConfig >;
+#endif
 
             using ConnectHandler = std::function< void ( std::error_code ec ) >;
-            using ActionHandler = std::function< void ( nlohmann::json&& response, std::error_code ec ) >;
+            using ActionHandler = std::function< void ( Response const& response, std::error_code ec ) >;
 
             enum Status
             {
@@ -47,69 +154,172 @@ namespace gcu {
                 CLOSING
             };
 
+            // every caller of a coalesced action brings its own handler and cancellation
+            struct Waiter
+            {
+                ActionHandler handler;
+                CancellationToken cancellation;
+            };
+
             struct Action
             {
-                Action( std::intmax_t callbackId, nlohmann::json&& request, ActionHandler&& handler )
+                Action( std::intmax_t callbackId, char const* name, std::string&& request, ActionHandler&& handler,
+                        ActionOptions const& options )
                         : callbackId( callbackId )
+                        , name( name )
                         , request( std::move( request ) )
-                        , handler( std::move( handler ) )
+                        , options( options )
+                {
+                    waiters.push_back( { std::move( handler ), options.cancellation } );
+                }
+
+                bool cancelled() const
                 {
-                    this->request[ "callback_id" ] = callbackId;
+                    return std::all_of( waiters.begin(), waiters.end(), []( auto const& waiter ) {
+                        return waiter.cancellation.cancelled();
+                    } );
                 }
 
                 std::intmax_t callbackId;
-                nlohmann::json request;
-                ActionHandler handler;
-                bool pending {};
+                char const* name;
+                // serialized members of the request except callback_id, which is only added when sending
+                std::string request;
+                std::vector< Waiter > waiters;
+                ActionOptions options;
+                std::unique_ptr< asio::steady_timer > deadline;
+                bool login {};
+            };
+
+            using ActionList = std::list< Action >;
+
+            struct ActionQueue
+            {
+                ActionList actions;
+                std::size_t passedOver {};
             };
 
         public:
             Client( asio::io_service& service );
             Client( Client const& ) = delete;
-            ~Client();
 
             bool closed() const { return status_ == CLOSED; }
             bool connected() const { return status_ == CONNECTED; }
 
-            void retry( std::size_t retryCount ) { retryCount_ = retryCount; }
+            void retry( std::size_t retryCount );
+            void reconnectPolicy( BackoffPolicy const& policy );
+            void pipeline( std::size_t depth );
+            void starvation( std::size_t limit );
+            void timeout( std::chrono::milliseconds timeout );
+            void keepalive( std::chrono::milliseconds interval, std::chrono::milliseconds pongTimeout );
+            void compression( CompressionSettings const& settings );
+            // takes effect with the next connect, a request for TLS is refused in builds without it
+            void tls( gcu::tls::Settings const& settings );
 
             void connect(
                     std::string const& hostname, std::uint16_t port, std::string const& apikey,
                     ConnectHandler&& handler );
             void close();
-            void send( nlohmann::json&& request, ActionHandler&& handler );
+            // drops all queued actions without answering them and lets the io_service run out of work
+            void shutdown();
+            void watchEvent( std::string type );
+            void send(
+                    char const* name, std::string&& request, ActionHandler&& handler, ActionOptions const& options = {} );
 
             ClientEvents& events() { return events_; }
+            LinkStats linkStats() const;
+
+            // an empty buffer for the next request, reusing one of a finished action where possible
+            std::string requestBuffer();
 
         private:
             void handleOpen();
+            void handleLogin( std::error_code ec );
             void handleFail();
             void handleClose();
             void handleMessage( websocketclient::message_ptr message );
-            void handleActionResponse( std::intmax_t callbackId, nlohmann::json&& response );
-            void handleEvent( nlohmann::json&& event );
+            void handleActionResponse( std::intmax_t callbackId, Response const& response );
+            void handleEvents( std::string_view events );
+            void handleEvent( std::string_view type, std::string const& printer );
+            void handlePong();
+            void handlePongTimeout();
+
+            void schedulePing();
+            void sendPing();
 
             bool reconnect();
+            void replayPendingActions();
             void connect();
+            ActionQueue& actionQueue( Priority priority ) { return actionQueues_[ (std::size_t) priority ]; }
+            ActionQueue* nextActionQueue();
+            bool readyToSend( Action const& action ) const;
+            bool coalesce( std::string const& request, ActionHandler&& handler, ActionOptions const& options );
+            void dropCancelled();
+            void release( ActionList& actions );
+            void recycle( std::string&& buffer );
+            void arm( Action& action );
+            void expire( std::intmax_t callbackId );
+            void enqueue(
+                    char const* name, std::string&& request, ActionHandler&& handler, ActionOptions const& options );
             void sendIfReady();
-            void close( bool checked );
+            void disconnect();
             void forceClose();
 
+            // runs the function with the endpoint of the current connection, plain or secure
+            template< typename Func >
+            void endpoint( Func&& func );
+            template< typename Endpoint >
+            void open( Endpoint& endpoint );
+#ifdef GCU_TLS
+            bool prepareTls();
+            void reportTls();
+#endif
+
+            void deliver( ActionList& actions, Response const& response, std::error_code ec );
+            void publish( LinkStats const& stats );
+            void lose( std::error_code ec );
             void propagateError( std::error_code ec );
 
-            std::size_t retryCount_;
-            std::size_t errorCount_;
+            asio::io_service& service_;
+            asio::io_service::strand strand_;
+            asio::io_service::strand deliveryStrand_;
+            Backoff backoff_;
+            asio::steady_timer reconnectTimer_;
+            std::chrono::milliseconds timeout_ { 30000 };
+            asio::steady_timer pingTimer_;
+            std::chrono::milliseconds pingInterval_ {};
+            std::chrono::milliseconds pongTimeout_ {};
+            std::chrono::steady_clock::time_point pingSent_;
+            std::array< std::chrono::microseconds, 64 > rttSamples_;
+            LinkStats linkStats_;
+            LinkStats publishedStats_;
+            mutable std::mutex statsMutex_;
+            CompressionSettings compression_;
+            gcu::tls::Settings tls_;
+            bool secure_ {};
+            std::size_t pipelineDepth_ { 1 };
+            std::size_t starvationLimit_ { 8 };
             websocketclient wsclient_;
+#ifdef GCU_TLS
+            securewebsocketclient wssclient_;
+#endif
             websocketpp::connection_hdl wshandle_;
-            Status status_ { CLOSED };
-            std::string const* hostname_;
+            std::atomic< Status > status_ { CLOSED };
+            std::string hostname_;
             std::uint16_t port_;
-            std::string const* apikey_;
+            std::string apikey_;
             ConnectHandler connectHandler_;
             std::intmax_t loginCallbackId_;
             std::intmax_t nextCallbackId_ {};
-            std::list< Action > actionQueue_;
-            std::recursive_mutex actionMutex_;
+            std::array< ActionQueue, priorityCount > actionQueues_;
+            ActionList pendingActions_;
+            std::unordered_map< std::intmax_t, ActionList::iterator > pendingIndex_;
+            // keyed by the request of the indexed action itself, which stays put while it is listed
+            std::unordered_map< std::string_view, ActionList::iterator > coalescingIndex_;
+            std::string sendBuffer_;
+            // taken by action builders on the callers' threads, so not owned by the strand
+            std::mutex buffersMutex_;
+            std::vector< std::string > spareBuffers_;
+            std::vector< std::string > watchedEvents_ { "printerListChanged", "modelGroupListChanged", "jobsChanged" };
             ClientEvents events_;
         };
 
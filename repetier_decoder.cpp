@@ -0,0 +1,139 @@
+#include <chrono>
+#include <string>
+#include <utility>
+
+#include "repetier_decoder.hpp"
+#include "repetier_error.hpp"
+
+namespace gcu {
+    namespace repetier {
+        namespace decode {
+
+            template< typename Element >
+            static std::vector< Element > decodeArray(
+                    json::Reader& reader, std::error_code& ec, Element ( *element )( json::Reader& ) )
+            {
+                std::vector< Element > result;
+                reader.beginArray();
+                while ( reader.nextElement() ) {
+                    result.push_back( element( reader ) );
+                }
+                if ( reader.failed() ) {
+                    ec = Error::malformedResponse;
+                    result.clear();
+                }
+                return result;
+            }
+
+            template< typename Handler >
+            static void decodeMembers( json::Reader& reader, Handler&& handler )
+            {
+                std::string_view key;
+                reader.beginObject();
+                while ( reader.nextMember( key ) ) {
+                    if ( !handler( key ) ) {
+                        reader.skipValue();
+                    }
+                }
+            }
+
+            static Printer printer( json::Reader& reader )
+            {
+                bool active {};
+                std::string name;
+                std::string slug;
+                decodeMembers( reader, [&]( std::string_view key ) {
+                    return key == "active" ? ( active = reader.readBool(), true ) :
+                           key == "name" ? ( name = reader.readString(), true ) :
+                           key == "slug" ? ( slug = reader.readString(), true ) : false;
+                } );
+                return Printer( active, std::move( name ), std::move( slug ) );
+            }
+
+            static Model model( json::Reader& reader )
+            {
+                std::size_t id {};
+                std::string name;
+                std::string group;
+                std::time_t created {};
+                std::size_t length {};
+                std::size_t layers {};
+                std::size_t lines {};
+                double printTime {};
+                decodeMembers( reader, [&]( std::string_view key ) {
+                    return key == "id" ? ( id = reader.readUnsigned(), true ) :
+                           key == "name" ? ( name = reader.readString(), true ) :
+                           key == "group" ? ( group = reader.readString(), true ) :
+                           key == "created" ? ( created = reader.readUnsigned() / 1000, true ) :
+                           key == "length" ? ( length = reader.readUnsigned(), true ) :
+                           key == "layer" ? ( layers = reader.readUnsigned(), true ) :
+                           key == "lines" ? ( lines = reader.readUnsigned(), true ) :
+                           key == "printTime" ? ( printTime = reader.readDouble(), true ) : false;
+                } );
+                return Model(
+                        id, std::move( name ), std::move( group ), created, length, layers, lines,
+                        std::chrono::milliseconds( (std::uint64_t) ( printTime * 1000.0 ) ) );
+            }
+
+            static ModelGroup modelGroup( json::Reader& reader )
+            {
+                return ModelGroup( reader.readString() );
+            }
+
+            std::vector< Printer > printers( json::Reader& reader, std::error_code& ec )
+            {
+                return decodeArray( reader, ec, printer );
+            }
+
+            std::vector< Model > models( json::Reader& reader, std::error_code& ec )
+            {
+                std::vector< Model > result;
+                decodeMembers( reader, [&]( std::string_view key ) {
+                    return key == "data" ? ( result = decodeArray( reader, ec, model ), true ) : false;
+                } );
+                if ( reader.failed() ) {
+                    ec = Error::malformedResponse;
+                }
+                return result;
+            }
+
+            std::vector< ModelGroup > modelGroups( json::Reader& reader, std::error_code& ec )
+            {
+                bool ok {};
+                std::vector< ModelGroup > result;
+                decodeMembers( reader, [&]( std::string_view key ) {
+                    return key == "ok" ? ( ok = reader.readBool(), true ) :
+                           key == "groupNames" ? ( result = decodeArray( reader, ec, modelGroup ), true ) : false;
+                } );
+                if ( reader.failed() ) {
+                    ec = Error::malformedResponse;
+                }
+                else if ( !ok ) {
+                    ec = Error::rejected;
+                }
+                return result;
+            }
+
+            bool ok( json::Reader& reader, std::error_code& ec )
+            {
+                bool ok {};
+                decodeMembers( reader, [&]( std::string_view key ) {
+                    return key == "ok" ? ( ok = reader.readBool(), true ) : false;
+                } );
+                if ( reader.failed() ) {
+                    ec = Error::malformedResponse;
+                }
+                else if ( !ok ) {
+                    ec = Error::rejected;
+                }
+                return ok;
+            }
+
+            bool ignore( json::Reader&, std::error_code& )
+            {
+                return true;
+            }
+
+        } // namespace decode
+    } // namespace repetier
+} // namespace gcu
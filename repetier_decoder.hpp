@@ -0,0 +1,25 @@
+#ifndef GCODEUPLOADER_REPETIER_DECODER_HPP
+#define GCODEUPLOADER_REPETIER_DECODER_HPP
+
+#include <system_error>
+#include <vector>
+
+#include "json_reader.hpp"
+#include "repetier_definitions.hpp"
+
+namespace gcu {
+    namespace repetier {
+        namespace decode {
+
+            std::vector< Printer > printers( json::Reader& reader, std::error_code& ec );
+            std::vector< Model > models( json::Reader& reader, std::error_code& ec );
+            std::vector< ModelGroup > modelGroups( json::Reader& reader, std::error_code& ec );
+            // for answers that only confirm success through their "ok" flag
+            bool ok( json::Reader& reader, std::error_code& ec );
+            bool ignore( json::Reader& reader, std::error_code& ec );
+
+        } // namespace decode
+    } // namespace repetier
+} // namespace gcu
+
+#endif //GCODEUPLOADER_REPETIER_DECODER_HPP
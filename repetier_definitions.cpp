@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
 #include "repetier_definitions.hpp"
 
 namespace gcu {
@@ -24,6 +28,65 @@ namespace gcu {
         {
         }
 
+        bool operator==( Model const& lhs, Model const& rhs )
+        {
+            return lhs.id() == rhs.id() && lhs.name() == rhs.name() && lhs.modelGroup() == rhs.modelGroup() &&
+                   lhs.created() == rhs.created() && lhs.length() == rhs.length() && lhs.layers() == rhs.layers() &&
+                   lhs.lines() == rhs.lines() && lhs.printTime() == rhs.printTime();
+        }
+
+        bool operator!=( Model const& lhs, Model const& rhs )
+        {
+            return !( lhs == rhs );
+        }
+
+        ModelDiff diffModels( std::vector< Model > const& before, std::vector< Model > const& after )
+        {
+            std::unordered_map< std::size_t, Model const* > previous;
+            previous.reserve( before.size() );
+            for ( auto const& model : before ) {
+                previous.emplace( model.id(), &model );
+            }
+
+            ModelDiff diff;
+            for ( auto const& model : after ) {
+                auto it = previous.find( model.id() );
+                if ( it == previous.end() ) {
+                    diff.added.push_back( model );
+                    continue;
+                }
+                if ( *it->second != model ) {
+                    diff.changed.push_back( model );
+                }
+                previous.erase( it );
+            }
+            for ( auto const& model : previous ) {
+                diff.removed.push_back( model.first );
+            }
+            return diff;
+        }
+
+        std::vector< std::size_t > modelIds( std::vector< Model > const& models )
+        {
+            std::vector< std::size_t > ids;
+            ids.reserve( models.size() );
+            for ( auto const& model : models ) {
+                ids.push_back( model.id() );
+            }
+            std::sort( ids.begin(), ids.end() );
+            return ids;
+        }
+
+        bool uploadArrived(
+                std::vector< Model > const& models, std::vector< std::size_t > const& known, std::string const& name,
+                std::string const& modelGroup, std::size_t length )
+        {
+            return std::any_of( models.begin(), models.end(), [&]( auto const& model ) {
+                return model.name() == name && model.modelGroup() == modelGroup && model.length() == length &&
+                       !std::binary_search( known.begin(), known.end(), model.id() );
+            } );
+        }
+
         bool ModelGroup::defaultGroup( std::string const& name )
         {
             return name == "#";
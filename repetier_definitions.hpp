@@ -3,11 +3,14 @@
 
 #include <ctime>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <system_error>
 #include <vector>
 
+#include "cancellation.hpp"
+
 namespace gcu {
     namespace repetier {
 
@@ -53,6 +56,30 @@ namespace gcu {
             std::chrono::microseconds printTime_;
         };
 
+        bool operator==( Model const& lhs, Model const& rhs );
+        bool operator!=( Model const& lhs, Model const& rhs );
+
+        // what changed between two model lists of the same printer, keyed by model id
+        struct ModelDiff
+        {
+            std::vector< Model > added;
+            std::vector< Model > changed;
+            std::vector< std::size_t > removed;
+
+            bool empty() const { return added.empty() && changed.empty() && removed.empty(); }
+        };
+
+        ModelDiff diffModels( std::vector< Model > const& before, std::vector< Model > const& after );
+
+        // sorted ids of a model list, as a snapshot to tell later additions from models that were already there
+        std::vector< std::size_t > modelIds( std::vector< Model > const& models );
+
+        // whether a model with the name, group and byte length of an upload was added after the snapshot was taken;
+        // an older model of the same name and size doesn't count, it may be left over from a previous upload
+        bool uploadArrived(
+                std::vector< Model > const& models, std::vector< std::size_t > const& known, std::string const& name,
+                std::string const& modelGroup, std::size_t length );
+
         class ModelGroup
         {
         public:
@@ -67,6 +94,41 @@ namespace gcu {
             std::string name_;
         };
 
+        enum class Priority
+        {
+            INTERACTIVE,
+            BACKGROUND,
+            BULK
+        };
+
+        static constexpr std::size_t priorityCount = 3;
+
+        struct ActionOptions
+        {
+            Priority priority { Priority::INTERACTIVE };
+            // sent only after all earlier actions were answered, holds back later ones until answered itself
+            bool ordered {};
+            // identical requests that are still queued or in flight are answered by a single round trip
+            bool coalesce {};
+            // may be sent again when the connection was lost before its response arrived
+            bool idempotent {};
+            // zero selects the client's default timeout
+            std::chrono::milliseconds timeout {};
+            // a cancelled action is dropped while queued; once sent, its response is not handed to the caller
+            CancellationToken cancellation;
+        };
+
+        // counts the whole request, multipart framing included
+        struct UploadProgress
+        {
+            std::uint64_t sent {};
+            std::uint64_t total {};
+            // bytes per second since the previous report and since the upload started
+            double rate {};
+            double averageRate {};
+            std::chrono::seconds eta {};
+        };
+
         template< typename ...Args >
         using Callback = std::function< void ( Args..., std::error_code ) >;
 
@@ -0,0 +1,42 @@
+#include <string>
+
+#include "repetier_error.hpp"
+
+namespace gcu {
+    namespace repetier {
+
+        class ErrorCategory
+                : public std::error_category
+        {
+        public:
+            char const* name() const noexcept override
+            {
+                return "repetier";
+            }
+
+            std::string message( int error ) const override
+            {
+                switch ( (Error) error ) {
+                    case Error::timedOut: return "Repetier server did not answer in time";
+                    case Error::rejected: return "Repetier server rejected the request";
+                    case Error::malformedResponse: return "Repetier server sent a malformed response";
+                    case Error::connectionClosed: return "Connection to the Repetier server was closed";
+                    case Error::unknownPrinter: return "No printer server is configured for the printer";
+                }
+                return "Unknown Repetier error";
+            }
+        };
+
+        std::error_category const& errorCategory()
+        {
+            static ErrorCategory category;
+            return category;
+        }
+
+        std::error_code make_error_code( Error error )
+        {
+            return std::error_code( (int) error, errorCategory() );
+        }
+
+    } // namespace repetier
+} // namespace gcu
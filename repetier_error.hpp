@@ -0,0 +1,31 @@
+#ifndef GCODEUPLOADER_REPETIER_ERROR_HPP
+#define GCODEUPLOADER_REPETIER_ERROR_HPP
+
+#include <system_error>
+#include <type_traits>
+
+namespace gcu {
+    namespace repetier {
+
+        enum class Error
+        {
+            timedOut = 1,
+            rejected,
+            malformedResponse,
+            connectionClosed,
+            unknownPrinter
+        };
+
+        std::error_category const& errorCategory();
+
+        std::error_code make_error_code( Error error );
+
+    } // namespace repetier
+} // namespace gcu
+
+namespace std {
+    template<>
+    struct is_error_code_enum< gcu::repetier::Error > : true_type {};
+} // namespace std
+
+#endif //GCODEUPLOADER_REPETIER_ERROR_HPP
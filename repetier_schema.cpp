@@ -0,0 +1,27 @@
+#include "repetier_schema.hpp"
+
+namespace gcu {
+    namespace repetier {
+        namespace schema {
+
+            namespace field {
+
+                constexpr char ApiKey::key[];
+                constexpr char GroupName::key[];
+                constexpr char DelFiles::key[];
+                constexpr char Id::key[];
+
+            } // namespace field
+
+            constexpr char Login::name[];
+            constexpr char ListPrinter::name[];
+            constexpr char ListModels::name[];
+            constexpr char ListModelGroups::name[];
+            constexpr char AddModelGroup::name[];
+            constexpr char DelModelGroup::name[];
+            constexpr char RemoveModel::name[];
+            constexpr char MoveModelFileToGroup::name[];
+
+        } // namespace schema
+    } // namespace repetier
+} // namespace gcu
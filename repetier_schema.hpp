@@ -0,0 +1,187 @@
+#ifndef GCODEUPLOADER_REPETIER_SCHEMA_HPP
+#define GCODEUPLOADER_REPETIER_SCHEMA_HPP
+
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "std/string_view.hpp"
+
+#include "json_reader.hpp"
+#include "repetier_decoder.hpp"
+#include "repetier_definitions.hpp"
+
+namespace gcu {
+    namespace repetier {
+
+        // Compile-time descriptions of the Repetier actions: their name, the typed members of "data" in order, whether
+        // they address a printer, their default options and how their answer is decoded. Result is void for actions
+        // that only report success.
+        namespace schema {
+
+            namespace field {
+
+                struct ApiKey
+                {
+                    using Type = std::string_view;
+                    static constexpr char key[] = "apikey";
+                };
+
+                struct GroupName
+                {
+                    using Type = std::string_view;
+                    static constexpr char key[] = "groupName";
+                };
+
+                struct DelFiles
+                {
+                    using Type = bool;
+                    static constexpr char key[] = "delFiles";
+                };
+
+                struct Id
+                {
+                    using Type = std::size_t;
+                    static constexpr char key[] = "id";
+                };
+
+            } // namespace field
+
+            template< typename ...Members >
+            struct Fields
+            {
+                static constexpr std::size_t size = sizeof...( Members );
+            };
+
+            struct Schema
+            {
+                static constexpr bool printerScoped = true;
+                static constexpr bool ordered = false;
+                static constexpr bool coalesce = false;
+                static constexpr bool idempotent = false;
+            };
+
+            struct Login : Schema
+            {
+                static constexpr char name[] = "login";
+                static constexpr bool printerScoped = false;
+                static constexpr bool ordered = true;
+                using Arguments = Fields< field::ApiKey >;
+                using Result = void;
+                static bool decode( json::Reader& reader, std::error_code& ec )
+                {
+                    return decode::ok( reader, ec );
+                }
+            };
+
+            struct ListPrinter : Schema
+            {
+                static constexpr char name[] = "listPrinter";
+                static constexpr bool printerScoped = false;
+                static constexpr bool coalesce = true;
+                static constexpr bool idempotent = true;
+                using Arguments = Fields<>;
+                using Result = std::vector< Printer >;
+                static Result decode( json::Reader& reader, std::error_code& ec )
+                {
+                    return decode::printers( reader, ec );
+                }
+            };
+
+            struct ListModels : Schema
+            {
+                static constexpr char name[] = "listModels";
+                static constexpr bool coalesce = true;
+                static constexpr bool idempotent = true;
+                using Arguments = Fields<>;
+                using Result = std::vector< Model >;
+                static Result decode( json::Reader& reader, std::error_code& ec )
+                {
+                    return decode::models( reader, ec );
+                }
+            };
+
+            struct ListModelGroups : Schema
+            {
+                static constexpr char name[] = "listModelGroups";
+                static constexpr bool coalesce = true;
+                static constexpr bool idempotent = true;
+                using Arguments = Fields<>;
+                using Result = std::vector< ModelGroup >;
+                static Result decode( json::Reader& reader, std::error_code& ec )
+                {
+                    return decode::modelGroups( reader, ec );
+                }
+            };
+
+            struct AddModelGroup : Schema
+            {
+                static constexpr char name[] = "addModelGroup";
+                static constexpr bool ordered = true;
+                // adding a group that an unanswered first attempt already added is refused by the server
+                using Arguments = Fields< field::GroupName >;
+                using Result = void;
+                static bool decode( json::Reader& reader, std::error_code& ec )
+                {
+                    return decode::ok( reader, ec );
+                }
+            };
+
+            struct DelModelGroup : Schema
+            {
+                static constexpr char name[] = "delModelGroup";
+                static constexpr bool ordered = true;
+                using Arguments = Fields< field::GroupName, field::DelFiles >;
+                using Result = void;
+                static bool decode( json::Reader& reader, std::error_code& ec )
+                {
+                    return decode::ok( reader, ec );
+                }
+            };
+
+            struct RemoveModel : Schema
+            {
+                static constexpr char name[] = "removeModel";
+                static constexpr bool ordered = true;
+                using Arguments = Fields< field::Id >;
+                using Result = void;
+                static bool decode( json::Reader& reader, std::error_code& ec )
+                {
+                    return decode::ignore( reader, ec );
+                }
+            };
+
+            struct MoveModelFileToGroup : Schema
+            {
+                static constexpr char name[] = "moveModelFileToGroup";
+                static constexpr bool ordered = true;
+                static constexpr bool idempotent = true;
+                using Arguments = Fields< field::GroupName, field::Id >;
+                using Result = void;
+                static bool decode( json::Reader& reader, std::error_code& ec )
+                {
+                    return decode::ok( reader, ec );
+                }
+            };
+
+            // which argument types a field takes without a silent conversion between text, numbers and flags
+            template< typename Type, typename Arg >
+            struct Accepts : std::is_convertible< Arg, Type > {};
+
+            template< typename Arg >
+            struct Accepts< bool, Arg > : std::is_same< Arg, bool > {};
+
+            // ids are unsigned, a negative one would wrap around to a huge id
+            template< typename Arg >
+            struct Accepts< std::size_t, Arg >
+                    : std::integral_constant<
+                            bool, std::is_unsigned< Arg >::value && !std::is_same< Arg, bool >::value > {};
+
+        } // namespace schema
+
+    } // namespace repetier
+} // namespace gcu
+
+#endif //GCODEUPLOADER_REPETIER_SCHEMA_HPP
@@ -0,0 +1,725 @@
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
+#include <istream>
+#include <random>
+#include <sstream>
+#include <utility>
+
+#ifdef __linux__
+#   include <fcntl.h>
+#   include <sys/sendfile.h>
+#   include <unistd.h>
+#endif
+
+#include <asio/buffers_iterator.hpp>
+#include <asio/connect.hpp>
+#include <asio/read.hpp>
+#include <asio/read_until.hpp>
+#include <asio/write.hpp>
+
+#include "conversion.hpp"
+#include "http.hpp"
+#include "json_reader.hpp"
+#include "log.hpp"
+#include "repetier_error.hpp"
+#include "repetier_upload.hpp"
+
+namespace gcu {
+    namespace repetier {
+
+        static std::size_t const chunkSize = 64 * 1024;
+
+        static std::string makeBoundary()
+        {
+            static char const digits[] = "0123456789abcdef";
+
+            std::random_device random;
+            std::string boundary( "gcodeUploader-" );
+            for ( int i = 0; i < 24; ++i ) {
+                boundary += digits[ random() % 16 ];
+            }
+            return boundary;
+        }
+
+        // the filename is only informational to the server, keep it from breaking the header
+        static std::string sanitize( std::string value )
+        {
+            std::replace_if( value.begin(), value.end(), []( char c ) {
+                return c == '"' || c == '\r' || c == '\n' || c == '\\';
+            }, '_' );
+            return value;
+        }
+
+        static std::string trim( std::string const& value )
+        {
+            auto first = value.find_first_not_of( " \t\r" );
+            if ( first == std::string::npos ) {
+                return {};
+            }
+            return value.substr( first, value.find_last_not_of( " \t\r" ) - first + 1 );
+        }
+
+        static std::string lower( std::string value )
+        {
+            std::transform( value.begin(), value.end(), value.begin(), []( char c ) {
+                return (char) std::tolower( (unsigned char) c );
+            } );
+            return value;
+        }
+
+        Uploader::Uploader(
+                asio::io_service& service, std::string hostname, std::uint16_t port, std::string apikey,
+                gcu::tls::Settings tls, std::shared_ptr< TokenBucket > bandwidth )
+                : service_( service )
+                , strand_( service )
+                , resolver_( service )
+                , deadline_( service )
+                , pause_( service )
+                , hostname_( std::move( hostname ) )
+                , port_( port )
+                , apikey_( std::move( apikey ) )
+                , tls_( std::move( tls ) )
+                , bandwidth_( std::move( bandwidth ) )
+                , chunk_( chunkSize )
+        {
+        }
+
+        void Uploader::upload( Upload upload, ProgressCallback progress, Callback<> callback )
+        {
+            strand_.dispatch( [this, self = shared_from_this(), upload = std::move( upload ),
+                                      progress = std::move( progress ), callback = std::move( callback )]() mutable {
+                if ( closed_ ) {
+                    service_.post( [callback = std::move( callback )] {
+                        callback( make_error_code( asio::error::operation_aborted ) );
+                    } );
+                    return;
+                }
+                queue_.push_back( { std::move( upload ), std::move( progress ), std::move( callback ) } );
+                if ( queue_.size() == 1 ) {
+                    next();
+                }
+            } );
+        }
+
+        void Uploader::shutdown()
+        {
+            strand_.dispatch( [this, self = shared_from_this()] {
+                closed_ = true;
+                // the transfer in flight included, its completion handlers are dropped by close()
+                for ( auto& pending : queue_ ) {
+                    service_.post( [callback = std::move( pending.callback )] {
+                        callback( make_error_code( asio::error::operation_aborted ) );
+                    } );
+                }
+                queue_.clear();
+                close();
+                closeFile();
+            } );
+        }
+
+        template< typename Func >
+        void Uploader::stream( Func&& func )
+        {
+#ifdef GCU_TLS
+            if ( secureSocket_ ) {
+                return func( *secureSocket_ );
+            }
+#endif
+            func( *socket_ );
+        }
+
+        template< typename Handler >
+        auto Uploader::bind( Handler handler )
+        {
+            return strand_.wrap( [this, self = shared_from_this(), generation = generation_, handler](
+                    auto const& ec, auto&&... args ) {
+                if ( generation == generation_ ) {
+                    handler( ec, args... );
+                }
+            } );
+        }
+
+        template< typename Then >
+        void Uploader::require( std::size_t count, Then then )
+        {
+            if ( response_.size() >= count ) {
+                return then();
+            }
+
+            arm();
+            stream( [&]( auto& stream ) {
+                asio::async_read( stream, response_, asio::transfer_exactly( count - response_.size() ),
+                                  this->bind( [this, then]( auto const& ec, std::size_t ) {
+                                      if ( ec ) {
+                                          return this->fail( ec );
+                                      }
+                                      then();
+                                  } ) );
+            } );
+        }
+
+        void Uploader::next()
+        {
+            if ( queue_.empty() ) {
+                deadline_.cancel();
+                return;
+            }
+
+            retried_ = false;
+            started_ = std::chrono::steady_clock::now();
+            std::error_code ec;
+            if ( !prepareRequest( ec ) ) {
+                return finish( ec );
+            }
+
+            reused_ = connected_;
+            if ( reused_ ) {
+                sendHead();
+            }
+            else {
+                open();
+            }
+        }
+
+        bool Uploader::prepareRequest( std::error_code& ec )
+        {
+            auto const& upload = queue_.front().upload;
+
+            size_ = std::filesystem::file_size( upload.gcodePath, ec );
+            if ( ec ) {
+                return false;
+            }
+            closeFile();
+#ifdef __linux__
+            if ( !tls_.enabled ) {
+                descriptor_ = ::open( upload.gcodePath.c_str(), O_RDONLY | O_CLOEXEC );
+                if ( descriptor_ == -1 ) {
+                    ec = std::error_code( errno, std::system_category() );
+                    return false;
+                }
+                offset_ = 0;
+            }
+            else
+#endif
+            {
+                file_.open( upload.gcodePath.string(), std::ios::in | std::ios::binary );
+                if ( !file_ ) {
+                    ec = std::make_error_code( std::errc::no_such_file_or_directory );
+                    return false;
+                }
+            }
+
+            auto boundary = makeBoundary();
+            auto part = [&boundary]( char const* name ) {
+                return cnv::toString( "--", boundary, "\r\nContent-Disposition: form-data; name=\"", name, "\"" );
+            };
+            auto preamble = cnv::toString(
+                    part( "a" ), "\r\n\r\nupload\r\n",
+                    part( "name" ), "\r\n\r\n", upload.modelName, "\r\n",
+                    part( "group" ), "\r\n\r\n", upload.modelGroup, "\r\n",
+                    part( "filename" ), "; filename=\"", sanitize( upload.gcodePath.filename().string() ), "\"\r\n",
+                    "Content-Type: application/octet-stream\r\n\r\n" );
+            tail_ = cnv::toString( "\r\n--", boundary, "--\r\n" );
+            head_ = cnv::toString(
+                    "POST /printer/model/", upload.printer, " HTTP/1.1\r\n",
+                    "Host: ", hostname_, ':', port_, "\r\n",
+                    "x-api-key: ", apikey_, "\r\n",
+                    "Content-Type: multipart/form-data; boundary=", boundary, "\r\n",
+                    "Content-Length: ", preamble.size() + size_ + tail_.size(), "\r\n",
+                    "Connection: keep-alive\r\n\r\n",
+                    preamble );
+            total_ = head_.size() + size_ + tail_.size();
+            return true;
+        }
+
+        void Uploader::closeFile()
+        {
+            file_.close();
+            file_.clear();
+#ifdef __linux__
+            if ( descriptor_ != -1 ) {
+                ::close( descriptor_ );
+                descriptor_ = -1;
+            }
+#endif
+        }
+
+        void Uploader::open()
+        {
+            close();
+            if ( tls_.enabled && !gcu::tls::supported ) {
+                GCU_LOG_ERROR( "TLS requested but not built in (GCU_TLS), refusing to upload in clear text" );
+                return finish( std::make_error_code( std::errc::protocol_not_supported ) );
+            }
+
+#ifdef GCU_TLS
+            if ( tls_.enabled ) {
+                if ( !context_ ) {
+                    if ( !tls_.sessions ) {
+                        tls_.sessions = std::make_shared< gcu::tls::SessionCache >();
+                    }
+
+                    std::error_code ec;
+                    context_ = gcu::tls::makeContext( tls_, hostname_, ec );
+                    if ( ec ) {
+                        return finish( ec );
+                    }
+                }
+                socket_.reset();
+                secureSocket_ = std::make_unique< asio::ssl::stream< asio::ip::tcp::socket > >( service_, *context_ );
+            }
+            else
+#endif
+            {
+                socket_ = std::make_unique< asio::ip::tcp::socket >( service_ );
+            }
+
+            GCU_LOG_DEBUG( "Opening upload connection to ", hostname_, ":", port_ );
+
+            arm();
+            asio::ip::tcp::resolver::query query( hostname_, std::to_string( port_ ) );
+            resolver_.async_resolve( query, bind( [this]( auto const& ec, auto endpoints ) {
+                if ( ec ) {
+                    return this->fail( ec );
+                }
+                this->connect( endpoints );
+            } ) );
+        }
+
+        void Uploader::connect( asio::ip::tcp::resolver::iterator endpoints )
+        {
+            stream( [&]( auto& stream ) {
+                asio::async_connect( stream.lowest_layer(), endpoints, this->bind( [this]( auto const& ec, auto ) {
+                    if ( ec ) {
+                        return this->fail( ec );
+                    }
+                    if ( tls_.enabled ) {
+                        return this->handshake();
+                    }
+                    connected_ = true;
+                    this->sendHead();
+                } ) );
+            } );
+        }
+
+        void Uploader::handshake()
+        {
+#ifdef GCU_TLS
+            auto ssl = secureSocket_->native_handle();
+            SSL_set_tlsext_host_name( ssl, hostname_.c_str() );
+            tls_.sessions->resume( ssl, cnv::toString( hostname_, ':', port_ ) );
+
+            secureSocket_->async_handshake( asio::ssl::stream_base::client, bind( [this, ssl]( auto const& ec ) {
+                if ( ec ) {
+                    return this->fail( ec );
+                }
+                GCU_LOG_DEBUG( "Upload connection uses ", SSL_get_version( ssl ), ", ",
+                               SSL_session_reused( ssl ) ? "session resumed" : "full handshake" );
+                connected_ = true;
+                this->sendHead();
+            } ) );
+#endif
+        }
+
+        void Uploader::sendHead()
+        {
+            GCU_LOG_INFO( "Uploading ", queue_.front().upload.gcodePath, " to ", hostname_, ":", port_,
+                          reused_ ? " (connection reused)" : "" );
+
+            responding_ = false;
+            sent_ = 0;
+            reportedSent_ = 0;
+            reported_ = std::chrono::steady_clock::now();
+            arm();
+            stream( [&]( auto& stream ) {
+                asio::async_write( stream, asio::buffer( head_ ), this->bind( [this]( auto const& ec, std::size_t ) {
+                    if ( ec ) {
+                        return this->fail( ec );
+                    }
+                    this->advance( head_.size() );
+                    this->sendFile();
+                } ) );
+            } );
+        }
+
+        void Uploader::sendFile()
+        {
+#ifdef __linux__
+            if ( descriptor_ != -1 ) {
+                return sendFileDirect();
+            }
+#endif
+            sendFileBuffered();
+        }
+
+#ifdef __linux__
+        void Uploader::sendFileDirect()
+        {
+            std::error_code ec;
+            socket_->non_blocking( true, ec );
+            if ( ec ) {
+                return fail( ec );
+            }
+
+            // sends until the socket buffer is full, then waits for it to drain without reading anything
+            while ( (std::uint64_t) offset_ < size_ ) {
+                std::uint64_t budget = size_ - offset_;
+                if ( !acquire( budget ) ) {
+                    return;
+                }
+
+                auto sent = ::sendfile( socket_->native_handle(), descriptor_, &offset_, budget );
+                auto error = errno;
+                if ( bandwidth_ ) {
+                    bandwidth_->refund( sent > 0 ? budget - (std::uint64_t) sent : budget );
+                }
+                if ( sent > 0 ) {
+                    advance( (std::uint64_t) sent );
+                    continue;
+                }
+                if ( sent == 0 ) {
+                    GCU_LOG_ERROR( "File ", queue_.front().upload.gcodePath, " shrank while uploading" );
+                    return fail( std::make_error_code( std::errc::io_error ) );
+                }
+                if ( error == EINTR ) {
+                    continue;
+                }
+                if ( error != EAGAIN ) {
+                    return fail( std::error_code( error, std::system_category() ) );
+                }
+
+                arm();
+                socket_->async_write_some( asio::null_buffers(), bind( [this]( auto const& ec, std::size_t ) {
+                    if ( ec ) {
+                        return this->fail( ec );
+                    }
+                    this->sendFileDirect();
+                } ) );
+                return;
+            }
+            sendTail();
+        }
+#endif
+
+        void Uploader::sendFileBuffered()
+        {
+            std::uint64_t budget = chunk_.size();
+            if ( !acquire( budget ) ) {
+                return;
+            }
+
+            file_.read( chunk_.data(), budget );
+            auto count = (std::size_t) file_.gcount();
+            if ( bandwidth_ ) {
+                bandwidth_->refund( budget - count );
+            }
+            if ( count == 0 ) {
+                if ( file_.bad() ) {
+                    return fail( std::make_error_code( std::errc::io_error ) );
+                }
+                return sendTail();
+            }
+
+            arm();
+            stream( [&]( auto& stream ) {
+                asio::async_write( stream, asio::buffer( chunk_.data(), count ),
+                                   this->bind( [this]( auto const& ec, std::size_t size ) {
+                                       if ( ec ) {
+                                           return this->fail( ec );
+                                       }
+                                       this->advance( size );
+                                       this->sendFileBuffered();
+                                   } ) );
+            } );
+        }
+
+        void Uploader::sendTail()
+        {
+            closeFile();
+            arm();
+            stream( [&]( auto& stream ) {
+                asio::async_write( stream, asio::buffer( tail_ ), this->bind( [this]( auto const& ec, std::size_t ) {
+                    if ( ec ) {
+                        return this->fail( ec );
+                    }
+                    this->advance( tail_.size() );
+                    this->receiveHead();
+                } ) );
+            } );
+        }
+
+        void Uploader::receiveHead()
+        {
+            arm();
+            stream( [&]( auto& stream ) {
+                asio::async_read_until( stream, response_, "\r\n\r\n", this->bind( [this](
+                        auto const& ec, std::size_t size ) {
+                    if ( ec ) {
+                        return this->fail( ec );
+                    }
+
+                    responding_ = true;
+                    std::string head( asio::buffers_begin( response_.data() ),
+                                      asio::buffers_begin( response_.data() ) + size );
+                    response_.consume( size );
+
+                    std::istringstream lines( head );
+                    std::string line;
+                    std::string version;
+                    std::getline( lines, line );
+                    if ( !( std::istringstream( line ) >> version >> status_ ) ) {
+                        return this->fail( Error::malformedResponse );
+                    }
+
+                    keepAlive_ = version == "HTTP/1.1";
+                    chunked_ = false;
+                    untilClose_ = true;
+                    contentLength_ = 0;
+                    while ( std::getline( lines, line ) ) {
+                        auto colon = line.find( ':' );
+                        if ( colon == std::string::npos ) {
+                            continue;
+                        }
+                        auto name = lower( trim( line.substr( 0, colon ) ) );
+                        auto value = lower( trim( line.substr( colon + 1 ) ) );
+                        if ( name == "content-length" ) {
+                            contentLength_ = std::strtoul( value.c_str(), nullptr, 10 );
+                            untilClose_ = false;
+                        }
+                        else if ( name == "transfer-encoding" && value.find( "chunked" ) != std::string::npos ) {
+                            chunked_ = true;
+                            untilClose_ = false;
+                        }
+                        else if ( name == "connection" ) {
+                            keepAlive_ = value == "keep-alive" || ( keepAlive_ && value != "close" );
+                        }
+                    }
+                    if ( untilClose_ ) {
+                        keepAlive_ = false;
+                    }
+                    this->receiveBody();
+                } ) );
+            } );
+        }
+
+        void Uploader::receiveBody()
+        {
+            body_.clear();
+            if ( chunked_ ) {
+                return receiveChunk();
+            }
+            if ( untilClose_ ) {
+                return receiveUntilClose();
+            }
+            require( contentLength_, [this] { this->complete( contentLength_ ); } );
+        }
+
+        void Uploader::receiveChunk()
+        {
+            arm();
+            stream( [&]( auto& stream ) {
+                asio::async_read_until( stream, response_, "\r\n", this->bind( [this](
+                        auto const& ec, std::size_t size ) {
+                    if ( ec ) {
+                        return this->fail( ec );
+                    }
+
+                    std::string line( asio::buffers_begin( response_.data() ),
+                                      asio::buffers_begin( response_.data() ) + size );
+                    response_.consume( size );
+                    auto length = std::strtoul( line.c_str(), nullptr, 16 );
+
+                    // the last chunk is followed by the (empty) trailer
+                    this->require( length + 2, [this, length] {
+                        body_.append( asio::buffers_begin( response_.data() ),
+                                      asio::buffers_begin( response_.data() ) + length );
+                        response_.consume( length + 2 );
+                        if ( length == 0 ) {
+                            return this->complete( 0 );
+                        }
+                        this->receiveChunk();
+                    } );
+                } ) );
+            } );
+        }
+
+        void Uploader::receiveUntilClose()
+        {
+            arm();
+            stream( [&]( auto& stream ) {
+                asio::async_read( stream, response_, this->bind( [this]( auto const& ec, std::size_t ) {
+                    if ( ec != asio::error::eof ) {
+#ifdef GCU_TLS
+                        if ( ec != asio::ssl::error::stream_truncated ) {
+                            return this->fail( ec );
+                        }
+#else
+                        return this->fail( ec );
+#endif
+                    }
+                    this->complete( response_.size() );
+                } ) );
+            } );
+        }
+
+        bool Uploader::acquire( std::uint64_t& budget )
+        {
+            if ( !bandwidth_ ) {
+                return true;
+            }
+
+            TokenBucket::Clock::duration wait {};
+            budget = bandwidth_->take( budget, wait );
+            if ( budget != 0 ) {
+                return true;
+            }
+
+            pause_.expires_from_now( wait );
+            pause_.async_wait( bind( [this]( auto const& ec ) {
+                if ( ec ) {
+                    return;
+                }
+                this->arm();
+                this->sendFile();
+            } ) );
+            return false;
+        }
+
+        void Uploader::advance( std::uint64_t bytes )
+        {
+            using namespace std::chrono;
+
+            sent_ += bytes;
+            auto now = steady_clock::now();
+            if ( now - reported_ < progressInterval_ && sent_ < total_ ) {
+                return;
+            }
+
+            auto elapsed = []( steady_clock::duration span ) {
+                return std::max( duration_cast< duration< double > >( span ).count(), 0.001 );
+            };
+            UploadProgress progress;
+            progress.sent = sent_;
+            progress.total = total_;
+            progress.rate = ( sent_ - reportedSent_ ) / elapsed( now - reported_ );
+            progress.averageRate = sent_ / elapsed( now - started_ );
+            progress.eta = duration_cast< std::chrono::seconds >(
+                    duration< double >( ( total_ - sent_ ) / progress.averageRate ) );
+            reported_ = now;
+            reportedSent_ = sent_;
+
+            auto const& callback = queue_.front().progress;
+            if ( callback ) {
+                service_.post( [callback, progress] { callback( progress ); } );
+            }
+        }
+
+        void Uploader::complete( std::size_t length )
+        {
+            body_.append( asio::buffers_begin( response_.data() ), asio::buffers_begin( response_.data() ) + length );
+            response_.consume( length );
+            if ( !keepAlive_ ) {
+                close();
+            }
+
+            if ( status_ < 200 || status_ >= 300 ) {
+                GCU_LOG_ERROR( "Upload to ", hostname_, ":", port_, " answered with HTTP status ", status_, ": ",
+                               log::truncate( body_, 80 ) );
+                return finish( http::statusError( status_ ) );
+            }
+
+            // Repetier answers with JSON, reporting problems like a missing printer in an error member
+            json::Reader reader( body_ );
+            if ( reader.peek() != json::Reader::OBJECT ) {
+                return finish( {} );
+            }
+
+            std::string_view key;
+            std::string error;
+            reader.beginObject();
+            while ( reader.nextMember( key ) ) {
+                if ( key == "error" ) {
+                    error = reader.readString();
+                }
+                else {
+                    reader.skipValue();
+                }
+            }
+
+            if ( reader.failed() ) {
+                GCU_LOG_WARN( "Malformed upload response: ", log::truncate( body_, 80 ) );
+                return finish( Error::malformedResponse );
+            }
+            if ( !error.empty() ) {
+                GCU_LOG_ERROR( "Upload rejected by ", hostname_, ":", port_, ": ", error );
+                return finish( Error::rejected );
+            }
+            finish( {} );
+        }
+
+        void Uploader::fail( std::error_code ec )
+        {
+            close();
+
+            // the server may have dropped the idle connection meanwhile, which shows before the first response byte
+            if ( reused_ && !responding_ && !retried_ ) {
+                GCU_LOG_DEBUG( "Reused upload connection failed (", ec.message(), "), retrying on a new one" );
+                retried_ = true;
+                reused_ = false;
+                if ( !prepareRequest( ec ) ) {
+                    return finish( ec );
+                }
+                return open();
+            }
+
+            GCU_LOG_ERROR( "Upload to ", hostname_, ":", port_, " failed: ", ec.message() );
+            finish( ec );
+        }
+
+        void Uploader::finish( std::error_code ec )
+        {
+            closeFile();
+
+            auto pending = std::move( queue_.front() );
+            queue_.pop_front();
+            service_.post( [callback = std::move( pending.callback ), ec] { callback( ec ); } );
+
+            next();
+        }
+
+        void Uploader::close()
+        {
+            ++generation_;
+            connected_ = false;
+            deadline_.cancel();
+            pause_.cancel();
+            resolver_.cancel();
+            response_.consume( response_.size() );
+
+            std::error_code ec;
+            if ( socket_ ) {
+                socket_->close( ec );
+            }
+#ifdef GCU_TLS
+            if ( secureSocket_ ) {
+                secureSocket_->lowest_layer().close( ec );
+            }
+#endif
+        }
+
+        void Uploader::arm()
+        {
+            deadline_.expires_from_now( timeout_ );
+            deadline_.async_wait( bind( [this]( auto const& ec ) {
+                if ( ec || deadline_.expires_at() > std::chrono::steady_clock::now() ) {
+                    return;
+                }
+                GCU_LOG_WARN( "Upload to ", hostname_, ":", port_, " stalled for ", timeout_.count(), "s" );
+                this->fail( Error::timedOut );
+            } ) );
+        }
+
+    } // namespace repetier
+} // namespace gcu
@@ -0,0 +1,157 @@
+#ifndef GCODEUPLOADER_REPETIER_UPLOAD_HPP
+#define GCODEUPLOADER_REPETIER_UPLOAD_HPP
+
+#include <cstdint>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef __linux__
+#   include <sys/types.h>
+#endif
+
+#include "std/filesystem.hpp"
+
+#include <asio/io_service.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/streambuf.hpp>
+#include <asio/strand.hpp>
+
+#include "repetier_definitions.hpp"
+#include "tls.hpp"
+#include "token_bucket.hpp"
+
+namespace gcu {
+    namespace repetier {
+
+        struct Upload
+        {
+            std::string printer;
+            // UTF-8, as sent to the server
+            std::string modelName;
+            std::string modelGroup;
+            std::filesystem::path gcodePath;
+        };
+
+        using ProgressCallback = std::function< void ( UploadProgress const& progress ) >;
+
+        // Streams G-code files to /printer/model/<slug> as multipart/form-data, one after another over a kept-alive
+        // HTTP connection. State is owned by a strand and pending handlers keep the uploader alive, like Client.
+        class Uploader
+                : public std::enable_shared_from_this< Uploader >
+        {
+        public:
+            // file data is only sent as fast as the bucket grants it, if there is one
+            Uploader(
+                    asio::io_service& service, std::string hostname, std::uint16_t port, std::string apikey,
+                    gcu::tls::Settings tls, std::shared_ptr< TokenBucket > bandwidth = nullptr );
+            Uploader( Uploader const& ) = delete;
+
+            // progress is reported at most every progressInterval and once the request is sent completely
+            void upload( Upload upload, ProgressCallback progress, Callback<> callback );
+            // fails queued uploads and the one in flight with operation_aborted and closes the connection
+            void shutdown();
+
+        private:
+            struct Pending
+            {
+                Upload upload;
+                ProgressCallback progress;
+                Callback<> callback;
+            };
+
+            template< typename Func >
+            void stream( Func&& func );
+            // completion handlers of a closed connection are dropped, its aborted operations must not touch the next
+            template< typename Handler >
+            auto bind( Handler handler );
+            template< typename Then >
+            void require( std::size_t count, Then then );
+
+            void next();
+            void open();
+            void connect( asio::ip::tcp::resolver::iterator endpoints );
+            void handshake();
+            void sendHead();
+            void sendFile();
+            void sendFileBuffered();
+#ifdef __linux__
+            void sendFileDirect();
+#endif
+            void sendTail();
+            void receiveHead();
+            void receiveBody();
+            void receiveChunk();
+            void receiveUntilClose();
+            void complete( std::size_t length );
+            void fail( std::error_code ec );
+            void finish( std::error_code ec );
+            void close();
+            void arm();
+
+            bool acquire( std::uint64_t& budget );
+            void advance( std::uint64_t bytes );
+
+            bool prepareRequest( std::error_code& ec );
+            void closeFile();
+
+            asio::io_service& service_;
+            asio::io_service::strand strand_;
+            asio::ip::tcp::resolver resolver_;
+            asio::steady_timer deadline_;
+            asio::steady_timer pause_;
+            std::chrono::seconds timeout_ { 30 };
+            std::chrono::milliseconds progressInterval_ { 250 };
+            std::string hostname_;
+            std::uint16_t port_;
+            std::string apikey_;
+            gcu::tls::Settings tls_;
+            std::shared_ptr< TokenBucket > bandwidth_;
+            std::unique_ptr< asio::ip::tcp::socket > socket_;
+#ifdef GCU_TLS
+            std::shared_ptr< asio::ssl::context > context_;
+            std::unique_ptr< asio::ssl::stream< asio::ip::tcp::socket > > secureSocket_;
+#endif
+            std::size_t generation_ {};
+            bool connected_ {};
+            bool reused_ {};
+            bool retried_ {};
+            bool closed_ {};
+            std::deque< Pending > queue_;
+
+            std::ifstream file_;
+#ifdef __linux__
+            // plain connections hand the file to the kernel with sendfile() instead of reading it through chunk_
+            int descriptor_ { -1 };
+            off_t offset_ {};
+#endif
+            std::uint64_t size_ {};
+            std::uint64_t sent_ {};
+            std::uint64_t total_ {};
+            std::chrono::steady_clock::time_point started_;
+            std::chrono::steady_clock::time_point reported_;
+            std::uint64_t reportedSent_ {};
+            std::string head_;
+            std::string tail_;
+            std::vector< char > chunk_;
+
+            asio::streambuf response_;
+            bool responding_ {};
+            unsigned status_ {};
+            bool keepAlive_ {};
+            bool chunked_ {};
+            std::size_t contentLength_ {};
+            bool untilClose_ {};
+            std::string body_;
+        };
+
+    } // namespace repetier
+} // namespace gcu
+
+#endif // GCODEUPLOADER_REPETIER_UPLOAD_HPP
@@ -0,0 +1,14 @@
+#ifndef GCODEUPLOADER_STRING_VIEW_HPP
+#define GCODEUPLOADER_STRING_VIEW_HPP
+
+#if __cplusplus < 201700L
+#   include <experimental/string_view>
+namespace std {
+    using std::experimental::basic_string_view;
+    using std::experimental::string_view;
+} // namespace std
+#else
+#   include <string_view>
+#endif
+
+#endif //GCODEUPLOADER_STRING_VIEW_HPP
@@ -0,0 +1,54 @@
+#include <chrono>
+
+#include "backoff.hpp"
+#include "check.hpp"
+
+using namespace gcu;
+
+static void growsFromTheInitialDelay()
+{
+    BackoffPolicy policy;
+    policy.jitter = 0.0;
+    Backoff backoff( policy );
+
+    GCU_CHECK( backoff.next() == std::chrono::milliseconds( 500 ) );
+    GCU_CHECK( backoff.next() == std::chrono::milliseconds( 1000 ) );
+    GCU_CHECK( backoff.next() == std::chrono::milliseconds( 2000 ) );
+    GCU_CHECK( backoff.attempts() == 3 );
+}
+
+static void jitterNeverExceedsTheCap()
+{
+    BackoffPolicy policy;
+    policy.jitter = 0.5;
+    policy.maxRetries = BackoffPolicy::unlimited;
+    Backoff backoff( policy );
+
+    for ( int i = 0; i < 1000; ++i ) {
+        auto delay = backoff.next();
+        GCU_CHECK( delay <= policy.maxDelay );
+        GCU_CHECK( delay >= std::chrono::milliseconds( 250 ) );
+    }
+}
+
+static void exhaustsAfterMaxRetries()
+{
+    BackoffPolicy policy;
+    policy.maxRetries = 2;
+    Backoff backoff( policy );
+
+    backoff.next();
+    GCU_CHECK( !backoff.exhausted() );
+    backoff.next();
+    GCU_CHECK( backoff.exhausted() );
+    backoff.reset();
+    GCU_CHECK( !backoff.exhausted() );
+}
+
+int main()
+{
+    growsFromTheInitialDelay();
+    jitterNeverExceedsTheCap();
+    exhaustsAfterMaxRetries();
+    return test::result();
+}
@@ -0,0 +1,33 @@
+#ifndef GCODEUPLOADER_CHECK_HPP
+#define GCODEUPLOADER_CHECK_HPP
+
+#include <cstdlib>
+#include <iostream>
+
+// Minimal assertions for the test executables: a failed check is reported and the test exits with 1 at the end
+#define GCU_CHECK( condition ) \
+        do { \
+            if ( !( condition ) ) { \
+                std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+                ::gcu::test::failed() = true; \
+            } \
+        } while ( false )
+
+namespace gcu {
+    namespace test {
+
+        inline bool& failed()
+        {
+            static bool failed {};
+            return failed;
+        }
+
+        inline int result()
+        {
+            return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+
+    } // namespace test
+} // namespace gcu
+
+#endif //GCODEUPLOADER_CHECK_HPP
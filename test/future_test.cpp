@@ -0,0 +1,67 @@
+#include <system_error>
+#include <vector>
+
+#include "check.hpp"
+#include "future.hpp"
+
+using namespace gcu;
+
+static void settledWaitsForAllAfterAnError()
+{
+    Promise<> first;
+    Promise<> second;
+    std::vector< Future<> > futures;
+    futures.push_back( first.future() );
+    futures.push_back( second.future() );
+
+    bool done {};
+    std::error_code result;
+    whenAllSettled( std::move( futures ) ).finally( [&]( std::error_code ec ) {
+        done = true;
+        result = ec;
+    } );
+
+    first.setError( std::make_error_code( std::errc::timed_out ) );
+    GCU_CHECK( !done );
+    second.setValue();
+    GCU_CHECK( done );
+    GCU_CHECK( result == std::errc::timed_out );
+}
+
+static void settledSucceedsWithoutErrors()
+{
+    std::vector< Future<> > futures;
+    futures.push_back( makeReadyFuture() );
+    futures.push_back( makeReadyFuture() );
+
+    bool done {};
+    std::error_code result = std::make_error_code( std::errc::timed_out );
+    whenAllSettled( std::move( futures ) ).finally( [&]( std::error_code ec ) {
+        done = true;
+        result = ec;
+    } );
+    GCU_CHECK( done );
+    GCU_CHECK( !result );
+}
+
+static void allFailsOnTheFirstError()
+{
+    Promise<> first;
+    Promise<> second;
+    std::vector< Future<> > futures;
+    futures.push_back( first.future() );
+    futures.push_back( second.future() );
+
+    bool done {};
+    whenAll( std::move( futures ) ).finally( [&]( std::error_code ) { done = true; } );
+    first.setError( std::make_error_code( std::errc::timed_out ) );
+    GCU_CHECK( done );
+}
+
+int main()
+{
+    settledWaitsForAllAfterAnError();
+    settledSucceedsWithoutErrors();
+    allFailsOnTheFirstError();
+    return test::result();
+}
@@ -0,0 +1,64 @@
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "repetier_definitions.hpp"
+
+using namespace gcu;
+using namespace gcu::repetier;
+
+static Model model( std::size_t id, std::string name, std::string group, std::size_t length )
+{
+    return Model( id, std::move( name ), std::move( group ), 0, length, 100, 1000, std::chrono::minutes( 5 ) );
+}
+
+static void newModelArrived()
+{
+    std::vector< Model > before { model( 1, "benchy", "#", 1024 ) };
+    auto known = modelIds( before );
+    std::vector< Model > after { model( 1, "benchy", "#", 1024 ), model( 7, "cube", "Calibration", 2048 ) };
+
+    GCU_CHECK( uploadArrived( after, known, "cube", "Calibration", 2048 ) );
+}
+
+static void staleModelDoesNotCount()
+{
+    // the same file was uploaded before, the retry must not mistake that model for the interrupted upload
+    std::vector< Model > before { model( 3, "cube", "Calibration", 2048 ) };
+    auto known = modelIds( before );
+
+    GCU_CHECK( !uploadArrived( before, known, "cube", "Calibration", 2048 ) );
+
+    std::vector< Model > after { model( 3, "cube", "Calibration", 2048 ), model( 4, "cube", "Calibration", 2048 ) };
+    GCU_CHECK( uploadArrived( after, known, "cube", "Calibration", 2048 ) );
+}
+
+static void newModelMustMatch()
+{
+    std::vector< std::size_t > known;
+    std::vector< Model > after { model( 5, "cube", "Calibration", 2048 ) };
+
+    GCU_CHECK( uploadArrived( after, known, "cube", "Calibration", 2048 ) );
+    GCU_CHECK( !uploadArrived( after, known, "cube", "Calibration", 2047 ) );
+    GCU_CHECK( !uploadArrived( after, known, "cube", "#", 2048 ) );
+    GCU_CHECK( !uploadArrived( after, known, "benchy", "Calibration", 2048 ) );
+    GCU_CHECK( !uploadArrived( {}, known, "cube", "Calibration", 2048 ) );
+}
+
+static void snapshotIsSorted()
+{
+    std::vector< Model > models { model( 9, "a", "#", 1 ), model( 2, "b", "#", 1 ), model( 5, "c", "#", 1 ) };
+
+    GCU_CHECK( modelIds( models ) == ( std::vector< std::size_t > { 2, 5, 9 } ) );
+    GCU_CHECK( !uploadArrived( models, modelIds( models ), "a", "#", 1 ) );
+}
+
+int main()
+{
+    newModelArrived();
+    staleModelDoesNotCount();
+    newModelMustMatch();
+    snapshotIsSorted();
+    return test::result();
+}
@@ -0,0 +1,240 @@
+#ifdef GCU_TLS
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+#ifndef _WIN32
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+#include "log.hpp"
+#include "tls.hpp"
+
+namespace gcu {
+    namespace tls {
+
+        static int contextIndex()
+        {
+            static int index = SSL_CTX_get_ex_new_index( 0, nullptr, nullptr, nullptr, nullptr );
+            return index;
+        }
+
+        static int peerIndex()
+        {
+            static int index = SSL_get_ex_new_index( 0, nullptr, nullptr, nullptr, nullptr );
+            return index;
+        }
+
+        // a corrupt or hand-edited file must not keep the application from starting
+        static bool decodeHex( std::string const& hex, std::string& decoded )
+        {
+            if ( hex.size() % 2 != 0 ) {
+                return false;
+            }
+
+            decoded.clear();
+            decoded.reserve( hex.size() / 2 );
+            for ( std::size_t i = 0; i < hex.size(); i += 2 ) {
+                // strtoul() alone would accept a sign or leading blanks
+                char digits[] { hex[ i ], hex[ i + 1 ], '\0' };
+                if ( !std::isxdigit( (unsigned char) digits[ 0 ] ) || !std::isxdigit( (unsigned char) digits[ 1 ] ) ) {
+                    return false;
+                }
+                char* end;
+                auto value = std::strtoul( digits, &end, 16 );
+                if ( end != digits + 2 ) {
+                    return false;
+                }
+                decoded.push_back( (char) value );
+            }
+            return true;
+        }
+
+        // the file is created readable by the owner only, so the secrets are never exposed while it is written
+        static bool createPrivate( std::string const& path )
+        {
+#ifdef _WIN32
+            return (bool) std::ofstream( path, std::ios::trunc );
+#else
+            ::unlink( path.c_str() );
+            int fd = ::open( path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600 );
+            if ( fd == -1 ) {
+                return false;
+            }
+            ::close( fd );
+            return true;
+#endif
+        }
+
+        SessionCache::SessionCache( std::filesystem::path file )
+                : file_( std::move( file ) )
+        {
+            if ( !file_.empty() ) {
+                load();
+            }
+        }
+
+        void SessionCache::attach( SSL_CTX* context )
+        {
+            SSL_CTX_set_ex_data( context, contextIndex(), this );
+            // OpenSSL's own store is per context, the cache outlives the contexts of single connections
+            SSL_CTX_set_session_cache_mode( context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE );
+            SSL_CTX_sess_set_new_cb( context, &SessionCache::onNewSession );
+        }
+
+        void SessionCache::resume( SSL* ssl, std::string const& peer )
+        {
+            std::lock_guard< std::mutex > lock( mutex_ );
+            auto it = sessions_.emplace( peer, std::string() ).first;
+            SSL_set_ex_data( ssl, peerIndex(), const_cast< std::string* >( &it->first ) );
+            if ( it->second.empty() ) {
+                return;
+            }
+
+            auto data = reinterpret_cast< unsigned char const* >( it->second.data() );
+            auto session = d2i_SSL_SESSION( nullptr, &data, (long) it->second.size() );
+            if ( session == nullptr ) {
+                GCU_LOG_WARN( "Discarding unreadable TLS session of ", peer );
+                it->second.clear();
+                return;
+            }
+            SSL_set_session( ssl, session );
+            SSL_SESSION_free( session );
+        }
+
+        int SessionCache::onNewSession( SSL* ssl, SSL_SESSION* session )
+        {
+            auto cache = static_cast< SessionCache* >( SSL_CTX_get_ex_data( SSL_get_SSL_CTX( ssl ), contextIndex() ) );
+            auto peer = static_cast< std::string const* >( SSL_get_ex_data( ssl, peerIndex() ) );
+            if ( cache != nullptr && peer != nullptr ) {
+                cache->store( *peer, session );
+            }
+            // the session was serialized, OpenSSL keeps its reference
+            return 0;
+        }
+
+        void SessionCache::store( std::string const& peer, SSL_SESSION* session )
+        {
+            auto length = i2d_SSL_SESSION( session, nullptr );
+            if ( length <= 0 ) {
+                return;
+            }
+            std::string encoded( (std::size_t) length, '\0' );
+            auto data = reinterpret_cast< unsigned char* >( &encoded[ 0 ] );
+            i2d_SSL_SESSION( session, &data );
+
+            GCU_LOG_DEBUG( "Storing TLS session of ", peer );
+
+            std::lock_guard< std::mutex > lock( mutex_ );
+            sessions_[ peer ] = std::move( encoded );
+            if ( !file_.empty() ) {
+                save();
+            }
+        }
+
+        void SessionCache::load()
+        {
+            std::ifstream stream( file_.string() );
+            std::string line;
+            while ( std::getline( stream, line ) ) {
+                std::istringstream fields( line );
+                std::string peer;
+                std::string hex;
+                std::string encoded;
+                if ( !( fields >> peer >> hex ) || !decodeHex( hex, encoded ) ) {
+                    GCU_LOG_WARN( "Skipping unreadable line in TLS session file ", file_.string() );
+                    continue;
+                }
+                sessions_[ peer ] = std::move( encoded );
+            }
+            GCU_LOG_DEBUG( "Loaded ", sessions_.size(), " TLS sessions from ", file_.string() );
+        }
+
+        // written to a private temporary that replaces the file, so a failed write leaves the old sessions intact
+        void SessionCache::save() const
+        {
+            auto temporary = file_.string() + ".tmp";
+            if ( !createPrivate( temporary ) ) {
+                GCU_LOG_WARN( "Creating ", temporary, " failed" );
+                return;
+            }
+
+            {
+                std::ofstream stream( temporary, std::ios::trunc );
+                stream << std::hex << std::setfill( '0' );
+                for ( auto const& entry : sessions_ ) {
+                    if ( entry.second.empty() ) {
+                        continue;
+                    }
+                    stream << entry.first << ' ';
+                    for ( auto c : entry.second ) {
+                        stream << std::setw( 2 ) << (unsigned) (unsigned char) c;
+                    }
+                    stream << '\n';
+                }
+                if ( !stream.flush() ) {
+                    GCU_LOG_WARN( "Writing TLS sessions to ", temporary, " failed" );
+                    std::remove( temporary.c_str() );
+                    return;
+                }
+            }
+
+            std::error_code ec;
+#ifdef _WIN32
+            // rename() does not replace an existing file there
+            std::filesystem::remove( file_, ec );
+#endif
+            std::filesystem::rename( temporary, file_, ec );
+            if ( ec ) {
+                GCU_LOG_WARN( "Replacing ", file_.string(), " failed: ", ec.message() );
+                std::remove( temporary.c_str() );
+            }
+        }
+
+        std::shared_ptr< asio::ssl::context > makeContext(
+                Settings const& settings, std::string const& hostname, std::error_code& ec )
+        {
+            auto context = std::make_shared< asio::ssl::context >( asio::ssl::context::sslv23_client );
+            context->set_options(
+                    asio::ssl::context::default_workarounds | asio::ssl::context::no_sslv2 |
+                    asio::ssl::context::no_sslv3 | asio::ssl::context::no_tlsv1 | asio::ssl::context::no_tlsv1_1 );
+
+            if ( settings.verifyPeer ) {
+                context->set_verify_mode( asio::ssl::verify_peer, ec );
+                if ( !ec ) {
+                    if ( settings.caFile.empty() ) {
+                        context->set_default_verify_paths( ec );
+                    }
+                    else {
+                        context->load_verify_file( settings.caFile, ec );
+                    }
+                }
+                if ( !ec ) {
+                    context->set_verify_callback( asio::ssl::rfc2818_verification( hostname ), ec );
+                }
+                if ( ec ) {
+                    GCU_LOG_ERROR( "Setting up TLS peer verification failed: ", ec.message() );
+                    return nullptr;
+                }
+            }
+            else {
+                GCU_LOG_WARN( "TLS peer verification of ", hostname, " is disabled" );
+                context->set_verify_mode( asio::ssl::verify_none );
+            }
+
+            if ( settings.sessions ) {
+                settings.sessions->attach( context->native_handle() );
+            }
+            return context;
+        }
+
+    } // namespace tls
+} // namespace gcu
+
+#endif // GCU_TLS
@@ -0,0 +1,72 @@
+#ifndef GCODEUPLOADER_TLS_HPP
+#define GCODEUPLOADER_TLS_HPP
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+
+#include "std/filesystem.hpp"
+
+#ifdef GCU_TLS
+#   include <asio/ssl.hpp>
+#endif
+
+namespace gcu {
+    namespace tls {
+
+#ifdef GCU_TLS
+        static constexpr bool supported = true;
+#else
+        static constexpr bool supported = false;
+#endif
+
+        class SessionCache;
+
+        // wss:// and https:// towards the printer servers; only honoured in builds with GCU_TLS
+        struct Settings
+        {
+            bool enabled {};
+            bool verifyPeer { true };
+            // PEM bundle trusted instead of the system store, e.g. the certificate of a local test server
+            std::string caFile;
+            // shared by all connections to resume sessions; a connection without one keeps a cache of its own
+            std::shared_ptr< SessionCache > sessions;
+        };
+
+#ifdef GCU_TLS
+        // Client sessions by "host:port", optionally persisted. The file holds resumption secrets, so it is
+        // written readable by the owner only.
+        class SessionCache
+        {
+        public:
+            explicit SessionCache( std::filesystem::path file = {} );
+            SessionCache( SessionCache const& ) = delete;
+
+            // sessions negotiated on connections of the context are stored from now on
+            void attach( SSL_CTX* context );
+            // offers the stored session of the peer, must be called before the handshake
+            void resume( SSL* ssl, std::string const& peer );
+
+        private:
+            static int onNewSession( SSL* ssl, SSL_SESSION* session );
+
+            void store( std::string const& peer, SSL_SESSION* session );
+            void load();
+            void save() const;
+
+            mutable std::mutex mutex_;
+            std::filesystem::path file_;
+            // DER encoded; keys are never erased, connections refer to them until their session arrives
+            std::map< std::string, std::string > sessions_;
+        };
+
+        std::shared_ptr< asio::ssl::context > makeContext(
+                Settings const& settings, std::string const& hostname, std::error_code& ec );
+#endif
+
+    } // namespace tls
+} // namespace gcu
+
+#endif // GCODEUPLOADER_TLS_HPP
@@ -0,0 +1,58 @@
+#include <algorithm>
+
+#include "token_bucket.hpp"
+
+namespace gcu {
+
+    TokenBucket::TokenBucket( std::uint64_t rate, std::uint64_t burst )
+            : rate_( rate )
+            , burst_( std::max( burst, rate ) )
+            , tokens_( (double) burst_ )
+            , updated_( Clock::now() )
+    {
+    }
+
+    void TokenBucket::rate( std::uint64_t rate, std::uint64_t burst )
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        refill( Clock::now() );
+        rate_ = rate;
+        burst_ = std::max( burst, rate );
+        tokens_ = std::min( tokens_, (double) burst_ );
+    }
+
+    std::uint64_t TokenBucket::take( std::uint64_t wanted, Clock::duration& wait )
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        if ( rate_ == 0 ) {
+            return wanted;
+        }
+
+        refill( Clock::now() );
+        auto granted = std::min( wanted, (std::uint64_t) tokens_ );
+        if ( granted == 0 ) {
+            // wait for a reasonable slice instead of a single byte
+            auto missing = std::max( std::min( (double) wanted, (double) rate_ / 20 ), 1.0 ) - tokens_;
+            wait = std::chrono::duration_cast< Clock::duration >( std::chrono::duration< double >( missing / rate_ ) );
+            return 0;
+        }
+        tokens_ -= granted;
+        return granted;
+    }
+
+    void TokenBucket::refund( std::uint64_t bytes )
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        if ( rate_ != 0 ) {
+            tokens_ = std::min( tokens_ + bytes, (double) burst_ );
+        }
+    }
+
+    void TokenBucket::refill( Clock::time_point now )
+    {
+        std::chrono::duration< double > elapsed = now - updated_;
+        tokens_ = std::min( tokens_ + elapsed.count() * rate_, (double) burst_ );
+        updated_ = now;
+    }
+
+} // namespace gcu
@@ -0,0 +1,39 @@
+#ifndef GCODEUPLOADER_TOKEN_BUCKET_HPP
+#define GCODEUPLOADER_TOKEN_BUCKET_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace gcu {
+
+    // Byte budget refilled at a fixed rate and shared between threads. A rate of zero grants everything at once.
+    class TokenBucket
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit TokenBucket( std::uint64_t rate = 0, std::uint64_t burst = 0 );
+        TokenBucket( TokenBucket const& ) = delete;
+
+        // bytes per second; the burst is what may be taken at once after the bucket was idle
+        void rate( std::uint64_t rate, std::uint64_t burst );
+
+        // grants up to wanted bytes, or none and sets how long to wait before asking again
+        std::uint64_t take( std::uint64_t wanted, Clock::duration& wait );
+        // returns granted bytes that were not used
+        void refund( std::uint64_t bytes );
+
+    private:
+        void refill( Clock::time_point now );
+
+        std::mutex mutex_;
+        std::uint64_t rate_;
+        std::uint64_t burst_;
+        double tokens_;
+        Clock::time_point updated_;
+    };
+
+} // namespace gcu
+
+#endif //GCODEUPLOADER_TOKEN_BUCKET_HPP
@@ -1,10 +1,15 @@
 #include <memory>
+#include <stdexcept>
+#include <vector>
 
 #include <boost/convert.hpp>
 #include <boost/convert/spirit.hpp>
 
+#include <wx/arrstr.h>
 #include <wx/cmdline.h>
+#include <wx/filename.h>
 #include <wx/msgdlg.h>
+#include <wx/stdpaths.h>
 
 #include "printer_service.hpp"
 #include <wx/msw/winundef.h>
@@ -17,11 +22,21 @@ namespace gct {
 
     static wxCmdLineEntryDesc cmdLineDesc[] {
             { wxCMD_LINE_OPTION, _( "H" ), _( "host" ), _( "Hostname of the printer server" ),
-                    wxCMD_LINE_VAL_STRING, wxCMD_LINE_OPTION_MANDATORY },
+                    wxCMD_LINE_VAL_STRING },
             { wxCMD_LINE_OPTION, _( "P" ), _( "port" ), _( "Port of the printer server" ),
-                    wxCMD_LINE_VAL_NUMBER, wxCMD_LINE_OPTION_MANDATORY },
+                    wxCMD_LINE_VAL_NUMBER },
             { wxCMD_LINE_OPTION, _( "a" ), _( "apikey" ), _( "API key for unrestricted access to the print server" ),
-                    wxCMD_LINE_VAL_STRING, wxCMD_LINE_OPTION_MANDATORY },
+                    wxCMD_LINE_VAL_STRING },
+            { wxCMD_LINE_OPTION, _( "f" ), _( "fleet" ),
+                    _( "Printer servers to manage together, as name=host:port:apikey[,...]" ), wxCMD_LINE_VAL_STRING },
+            { wxCMD_LINE_SWITCH, _( "s" ), _( "secure" ), _( "Connect to the printer servers with TLS (wss/https)" ) },
+            { wxCMD_LINE_OPTION, _( "c" ), _( "cafile" ),
+                    _( "PEM certificates to verify the printer servers with instead of the system store" ),
+                    wxCMD_LINE_VAL_STRING },
+            { wxCMD_LINE_SWITCH, _( "k" ), _( "insecure" ),
+                    _( "Skip verifying the certificates of the printer servers" ) },
+            { wxCMD_LINE_OPTION, _( "b" ), _( "bandwidth" ), _( "Upload bandwidth over all printer servers in kB/s" ),
+                    wxCMD_LINE_VAL_NUMBER },
             { wxCMD_LINE_OPTION, _( "p" ), _( "printer" ), _( "Printer that gets selected initially" ),
                     wxCMD_LINE_VAL_STRING },
             { wxCMD_LINE_OPTION, _( "m" ), _( "modelname" ), _( "Suggestion for model name" ),
@@ -32,6 +47,27 @@ namespace gct {
             { wxCMD_LINE_NONE }
     };
 
+    static bool parseFleet( wxString const& fleet, std::vector< gcu::ServerConfig >& servers )
+    {
+        for ( auto const& entry : wxSplit( fleet, ',' ) ) {
+            wxString name = entry.BeforeFirst( '=' );
+            // the apikey is whatever follows the port, colons included
+            wxString rest;
+            wxString hostname = entry.AfterFirst( '=' ).BeforeFirst( ':', &rest );
+            wxString apikey;
+            wxString portText = rest.BeforeFirst( ':', &apikey );
+            unsigned long port;
+            if ( name.empty() || hostname.empty() || !rest.Contains( ':' ) || !portText.ToULong( &port ) ||
+                    port > std::numeric_limits< std::uint16_t >::max() ) {
+                wxMessageBox( _( "Invalid printer server " ) + entry, _( "Error" ), wxOK | wxICON_ERROR );
+                return false;
+            }
+            servers.push_back( { name.ToStdString(), hostname.ToStdString(), (std::uint16_t) port,
+                                 apikey.ToStdString() } );
+        }
+        return true;
+    }
+
     GctApp::GctApp() = default;
 
     bool GctApp::OnInit()
@@ -40,8 +76,51 @@ namespace gct {
             return false;
         }
 
-        auto printerService = std::make_shared< gcu::PrinterService >(
-                hostname_.ToStdString(), port_, apikey_.ToStdString() );
+        std::vector< gcu::ServerConfig > servers;
+        if ( !fleet_.empty() ) {
+            if ( !parseFleet( fleet_, servers ) ) {
+                return false;
+            }
+        }
+        else {
+            servers.push_back( { {}, hostname_.ToStdString(), port_, apikey_.ToStdString() } );
+        }
+
+        if ( secure_ ) {
+            if ( !gcu::tls::supported ) {
+                wxMessageBox( _( "This build does not support TLS" ), _( "Error" ), wxOK | wxICON_ERROR );
+                return false;
+            }
+
+            gcu::tls::Settings tls;
+            tls.enabled = true;
+            tls.verifyPeer = !insecure_;
+            tls.caFile = caFile_.ToStdString();
+#ifdef GCU_TLS
+            // sessions survive the process, so the next upload resumes instead of doing a full handshake
+            wxString dataDir = wxStandardPaths::Get().GetUserDataDir();
+            wxFileName::Mkdir( dataDir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL );
+            tls.sessions = std::make_shared< gcu::tls::SessionCache >(
+                    wxFileName( dataDir, _( "tls_sessions" ) ).GetFullPath().ToStdString() );
+#endif
+            for ( auto& server : servers ) {
+                server.tls = tls;
+            }
+        }
+
+        std::shared_ptr< gcu::PrinterService > printerService;
+        try {
+            printerService = std::make_shared< gcu::PrinterService >( std::move( servers ) );
+            if ( bandwidth_ > 0 ) {
+                gcu::UploadPolicy policy;
+                policy.bandwidth = (std::uint64_t) bandwidth_ * 1024;
+                printerService->uploadPolicy( policy );
+            }
+        }
+        catch ( std::invalid_argument const& e ) {
+            wxMessageBox( e.what(), _( "Error" ), wxOK | wxICON_ERROR );
+            return false;
+        }
 
         wxFrame* frame;
         switch ( command_ ) {
@@ -66,11 +145,22 @@ namespace gct {
     {
         parser.Found( _( "H" ), &hostname_ );
         parser.Found( _( "a" ), &apikey_ );
+        parser.Found( _( "f" ), &fleet_ );
+        secure_ = parser.Found( _( "s" ) );
+        insecure_ = parser.Found( _( "k" ) );
+        parser.Found( _( "c" ), &caFile_ );
+        parser.Found( _( "b" ), &bandwidth_ );
         parser.Found( _( "p" ), &printer_ );
         parser.Found( _( "m" ), &modelName_ );
         deleteFile_ = parser.Found( _( "d" ) );
 
-        long port;
+        if ( fleet_.empty() && ( hostname_.empty() || apikey_.empty() || !parser.Found( _( "P" ) ) ) ) {
+            wxMessageBox( _( "Either host, port and apikey or a fleet of printer servers is required" ),
+                          _( "Error" ), wxOK | wxICON_ERROR );
+            return false;
+        }
+
+        long port = 0;
         parser.Found( _( "P" ), &port );
         if ( port < std::numeric_limits< std::uint16_t >::min() ||
                 port > std::numeric_limits< std::uint16_t >::max() ) {
@@ -29,6 +29,11 @@ namespace gct {
         wxString hostname_;
         std::uint16_t port_;
         wxString apikey_;
+        wxString fleet_;
+        bool secure_;
+        bool insecure_;
+        wxString caFile_;
+        long bandwidth_ {};
         wxString printer_;
         wxString modelName_;
         bool deleteFile_;
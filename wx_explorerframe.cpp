@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <iomanip>
+#include <iterator>
 #include <utility>
+#include <vector>
 
 #include <wx/msgdlg.h>
 #include <wx/textdlg.h>
@@ -92,6 +95,11 @@ namespace gct {
                 this->OnModelsChanged( printer, std::move( models ) );
             } );
         } );
+        printerService_->modelsDiffed.connect( [this]( auto const& printer, auto const& diff ) {
+            this->CallAfter( [=, diff = diff]() mutable {
+                this->OnModelsDiffed( printer, std::move( diff ) );
+            } );
+        } );
         printerService_->requestPrinters();
     }
 
@@ -121,6 +129,28 @@ namespace gct {
         selectedModels_.clear();
     }
 
+    void ExplorerFrame::InsertModel( gcu::repetier::Model&& model )
+    {
+        long index = modelsListCtrl_->InsertItem( modelsListCtrl_->GetItemCount(), model.name() );
+        modelsListCtrl_->SetItemData( index, (long) model.id() );
+        UpdateModelItem( index, model );
+        if ( selectedModels_.find( model.id() ) != selectedModels_.end() ) {
+            modelsListCtrl_->SetItemState( index, wxLIST_STATE_SELECTED, wxLIST_STATE_SELECTED );
+        }
+        models_.emplace( model.id(), std::move( model ) );
+    }
+
+    void ExplorerFrame::UpdateModelItem( long index, gcu::repetier::Model const& model )
+    {
+        modelsListCtrl_->SetItemText( index, model.name() );
+        modelsListCtrl_->SetItem(
+                index, 1, gcu::cnv::toString( std::put_time( std::localtime( &model.created() ), "%c" ) ) );
+        modelsListCtrl_->SetItem( index, 2, gcu::cnv::toString( formatFileSize( model.length() ) ) );
+        modelsListCtrl_->SetItem( index, 3, std::to_string( model.lines() ) );
+        modelsListCtrl_->SetItem( index, 4, gcu::cnv::toString( formatDuration( model.printTime() ) ) );
+        modelsListCtrl_->SetItem( index, 5, std::to_string( model.layers() ) );
+    }
+
     void ExplorerFrame::OnPrinterSelected()
     {
         int selection = printerChoice_->GetSelection();
@@ -132,7 +162,9 @@ namespace gct {
             InvalidateModels();
             RefreshControlStates();
 
-            printerService_->requestModelGroups( selectedPrinter_ );
+            requests_.cancel();
+            requests_ = gcu::CancellationToken::create();
+            printerService_->requestModelGroups( selectedPrinter_, requests_ );
         }
     }
 
@@ -146,7 +178,7 @@ namespace gct {
             InvalidateModels();
             RefreshControlStates();
 
-            printerService_->requestModels( selectedPrinter_ );
+            printerService_->requestModels( selectedPrinter_, requests_ );
         }
     }
 
@@ -156,7 +188,7 @@ namespace gct {
 
         long index = -1;
         while ( ( index = modelsListCtrl_->GetNextItem( index, wxLIST_NEXT_ALL, wxLIST_STATE_SELECTED ) ) != -1 ) {
-            selectedModels_.insert( models_.find( index )->second.id() );
+            selectedModels_.insert( (std::size_t) modelsListCtrl_->GetItemData( index ) );
         }
 
         RefreshControlStates();
@@ -171,8 +203,20 @@ namespace gct {
         if ( wxMessageBox(
                 gcu::cnv::toString( "Really remove ", selectedModels_.size(), " models?" ), _( "Question" ),
                 wxYES_NO | wxICON_QUESTION, this ) == wxYES ) {
-            std::for_each( selectedModels_.begin(), selectedModels_.end(), [this]( auto id ) {
-                printerService_->removeModel( selectedPrinter_, id );
+            std::vector< gcu::Future<> > removals;
+            std::transform(
+                    selectedModels_.begin(), selectedModels_.end(), std::back_inserter( removals ),
+                    [this]( auto id ) { return printerService_->removeModel( selectedPrinter_, id ); } );
+
+            // removals are ordered, so they run one after another; the frame is locked until the last one is through
+            Enable( false );
+            gcu::whenAllSettled( std::move( removals ) ).finally( [this]( std::error_code ec ) {
+                this->CallAfter( [this, ec] {
+                    Enable( true );
+                    if ( ec ) {
+                        OnRequestFailed( ec );
+                    }
+                } );
             } );
         }
     }
@@ -187,7 +231,12 @@ namespace gct {
             RefreshControlStates();
 
             selectedModelGroup_ = dialog.GetValue().ToStdString();
-            printerService_->addModelGroup( selectedPrinter_, selectedModelGroup_ );
+            printerService_->addModelGroup( selectedPrinter_, selectedModelGroup_ )
+                    .finally( [this]( std::error_code ec ) {
+                        if ( ec ) {
+                            this->CallAfter( [this, ec] { OnRequestFailed( ec ); } );
+                        }
+                    } );
         }
     }
 
@@ -201,7 +250,12 @@ namespace gct {
             }
         }
 
-        printerService_->delModelGroup( selectedPrinter_, selectedModelGroup_, true );
+        printerService_->delModelGroup( selectedPrinter_, selectedModelGroup_, true )
+                .finally( [this]( std::error_code ec ) {
+                    if ( ec ) {
+                        this->CallAfter( [this, ec] { OnRequestFailed( ec ); } );
+                    }
+                } );
     }
 
     void ExplorerFrame::OnConnectionLost( std::error_code ec )
@@ -210,6 +264,11 @@ namespace gct {
         Close();
     }
 
+    void ExplorerFrame::OnRequestFailed( std::error_code ec )
+    {
+        wxMessageBox( ec.message(), "Error", wxOK | wxICON_ERROR, this );
+    }
+
     void ExplorerFrame::OnPrintersChanged( std::vector< gcu::repetier::Printer >&& printers )
     {
         printerChoice_->Clear();
@@ -261,17 +320,7 @@ namespace gct {
 
             for ( auto&& model : models ) {
                 if ( model.modelGroup() == selectedModelGroup_ ) {
-                    long index = modelsListCtrl_->InsertItem( modelsListCtrl_->GetItemCount(), model.name() );
-                    modelsListCtrl_->SetItem(
-                            index, 1, gcu::cnv::toString( std::put_time( std::localtime( &model.created() ), "%c" ) ) );
-                    modelsListCtrl_->SetItem( index, 2, gcu::cnv::toString( formatFileSize( model.length() ) ) );
-                    modelsListCtrl_->SetItem( index, 3, std::to_string( model.lines() ) );
-                    modelsListCtrl_->SetItem( index, 4, gcu::cnv::toString( formatDuration( model.printTime() ) ) );
-                    modelsListCtrl_->SetItem( index, 5, std::to_string( model.layers() ) );
-                    if ( selectedModels_.find( model.id() ) != selectedModels_.end() ) {
-                        modelsListCtrl_->SetItemState( index, wxLIST_STATE_SELECTED, wxLIST_STATE_SELECTED );
-                    }
-                    models_.emplace( index, std::move( model ) );
+                    InsertModel( std::move( model ) );
                 }
             }
             modelsListCtrl_->Enable( true );
@@ -279,4 +328,41 @@ namespace gct {
         }
     }
 
+    void ExplorerFrame::OnModelsDiffed( std::string const& printer, gcu::repetier::ModelDiff&& diff )
+    {
+        if ( printer != selectedPrinter_ ) {
+            return;
+        }
+
+        auto remove = [this]( std::size_t id ) {
+            if ( models_.erase( id ) > 0 ) {
+                modelsListCtrl_->DeleteItem( modelsListCtrl_->FindItem( -1, (wxUIntPtr) id ) );
+            }
+        };
+
+        for ( auto id : diff.removed ) {
+            remove( id );
+        }
+        // a changed model may also have moved into or out of the selected group
+        for ( auto&& model : diff.changed ) {
+            auto it = models_.find( model.id() );
+            if ( model.modelGroup() != selectedModelGroup_ ) {
+                remove( model.id() );
+            }
+            else if ( it != models_.end() ) {
+                UpdateModelItem( modelsListCtrl_->FindItem( -1, (wxUIntPtr) model.id() ), model );
+                it->second = std::move( model );
+            }
+            else {
+                InsertModel( std::move( model ) );
+            }
+        }
+        for ( auto&& model : diff.added ) {
+            if ( model.modelGroup() == selectedModelGroup_ ) {
+                InsertModel( std::move( model ) );
+            }
+        }
+        OnModelsListItemSelected();
+    }
+
 } // namespace gct
\ No newline at end of file
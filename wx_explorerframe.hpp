@@ -7,6 +7,8 @@
 #include <unordered_map>
 #include <unordered_set>
 
+#include "cancellation.hpp"
+#include "repetier_definitions.hpp"
 #include "wx_generated.h"
 
 namespace gcu {
@@ -27,6 +29,8 @@ namespace gct {
         void RefreshControlStates();
         void InvalidateModelGroup();
         void InvalidateModels();
+        void InsertModel( gcu::repetier::Model&& model );
+        void UpdateModelItem( long index, gcu::repetier::Model const& model );
 
         void OnPrinterSelected();
         void OnModelGroupSelected();
@@ -37,15 +41,19 @@ namespace gct {
         void OnToolBarRemoveGroup();
 
         void OnConnectionLost( std::error_code ec );
+        void OnRequestFailed( std::error_code ec );
         void OnPrintersChanged( std::vector< gcu::repetier::Printer >&& printers );
         void OnModelGroupsChanged( std::string const& printer, std::vector< gcu::repetier::ModelGroup >&& modelGroups );
         void OnModelsChanged( std::string const& printer, std::vector< gcu::repetier::Model >&& models );
+        void OnModelsDiffed( std::string const& printer, gcu::repetier::ModelDiff&& diff );
 
         std::shared_ptr< gcu::PrinterService > printerService_;
         std::string selectedPrinter_;
         std::string selectedModelGroup_;
-        std::unordered_map< long, gcu::repetier::Model > models_;
+        std::unordered_map< std::size_t, gcu::repetier::Model > models_;
         std::unordered_set< std::size_t > selectedModels_;
+        // requests on behalf of the selected printer, cancelled when another one is selected
+        gcu::CancellationToken requests_;
 
     };
 
@@ -1,10 +1,9 @@
 #include <algorithm>
+#include <iterator>
 #include <locale>
 #include <utility>
 
-#include <wx/filename.h>
 #include <wx/msgdlg.h>
-#include <wx/stdpaths.h>
 #include <wx/textdlg.h>
 
 #include "printer_service.hpp"
@@ -56,6 +55,18 @@ namespace gct {
                 this->OnModelsChanged( printer, std::move( models ) );
             } );
         } );
+        printerService_->modelsDiffed.connect( [this]( auto const& printer, auto const& diff ) {
+            this->CallAfter( [=, diff = diff]() mutable {
+                this->OnModelsDiffed( printer, std::move( diff ) );
+            } );
+        } );
+        printerService_->uploadProgress.connect( [this]( auto const& printer, auto const& modelName, auto progress ) {
+            this->CallAfter( [=] {
+                if ( printer == selectedPrinter_ && modelName == enteredModelName_ ) {
+                    this->OnUploadProgress( progress );
+                }
+            } );
+        } );
         printerService_->requestPrinters();
     }
 
@@ -73,18 +84,11 @@ namespace gct {
         return it != models_.end() ? it->id() : MODEL_NOT_FOUND;
     }
 
-    void UploadFrame::PerformUpload(
-            wxString const& printer, wxString const& modelName, wxString const& modelGroup, bool deleteFile )
+    gcu::Future<> UploadFrame::PerformUpload(
+            wxString const& printer, wxString const& modelName, wxString const& modelGroup )
     {
-        printerService_->upload(
-                printer.ToStdString(), modelName.ToStdString(), modelGroup.ToStdString(), gcodePath_,
-                wxFileName(wxStandardPaths::Get().GetExecutablePath()).GetPath().ToStdString(),
-                [this, deleteFile]() {
-                    if ( deleteFile ) {
-                        std::remove( gcodePath_.string().c_str() );
-                    }
-                    Close();
-                } );
+        return printerService_->upload(
+                printer.ToStdString(), modelName.ToStdString(), modelGroup.ToStdString(), gcodePath_ );
     }
 
     void UploadFrame::OnPrinterSelected()
@@ -93,8 +97,10 @@ namespace gct {
         if ( selection != wxNOT_FOUND ) {
             selectedPrinter_ = wxClientPtrCast< gcu::repetier::Printer >(
                     printerChoice_->GetClientObject( (unsigned) selection ) ).slug();
-            printerService_->requestModelGroups( selectedPrinter_.ToStdString() );
-            printerService_->requestModels( selectedPrinter_.ToStdString() );
+            requests_.cancel();
+            requests_ = gcu::CancellationToken::create();
+            printerService_->requestModelGroups( selectedPrinter_.ToStdString(), requests_ );
+            printerService_->requestModels( selectedPrinter_.ToStdString(), requests_ );
         }
     }
 
@@ -115,7 +121,12 @@ namespace gct {
         // TODO: input validation
         if ( dialog.ShowModal() == wxID_OK ) {
             selectedModelGroup_ = dialog.GetValue();
-            printerService_->addModelGroup( selectedPrinter_.ToStdString(), selectedModelGroup_.ToStdString() );
+            printerService_->addModelGroup( selectedPrinter_.ToStdString(), selectedModelGroup_.ToStdString() )
+                    .finally( [this]( std::error_code ec ) {
+                        if ( ec ) {
+                            this->CallAfter( [this, ec] { OnRequestFailed( ec ); } );
+                        }
+                    } );
         }
     }
 
@@ -130,17 +141,36 @@ namespace gct {
         Enable( false );
 
         auto modelId = FindSelectedModelId();
-        if ( modelId != MODEL_NOT_FOUND ) {
-            printerService_->removeModel(
-                    selectedPrinter_.ToStdString(), modelId,
-                    [this, printer = selectedPrinter_, modelName = enteredModelName_,
-                            modelGroup = selectedModelGroup_, deleteFile = deleteFileCheckbox_->GetValue()] {
-                        PerformUpload( printer, modelName, modelGroup, deleteFile );
+        auto removed = modelId != MODEL_NOT_FOUND
+                ? printerService_->removeModel( selectedPrinter_.ToStdString(), modelId )
+                : gcu::makeReadyFuture();
+        std::move( removed )
+                .then( [this, printer = selectedPrinter_, modelName = enteredModelName_,
+                        modelGroup = selectedModelGroup_] {
+                    return PerformUpload( printer, modelName, modelGroup );
+                } )
+                .finally( [this, deleteFile = deleteFileCheckbox_->GetValue()]( std::error_code ec ) {
+                    this->CallAfter( [this, deleteFile, ec] {
+                        if ( ec ) {
+                            Enable( true );
+                            OnRequestFailed( ec );
+                            return;
+                        }
+                        if ( deleteFile ) {
+                            std::remove( gcodePath_.string().c_str() );
+                        }
+                        Close();
                     } );
-        }
-        else {
-            PerformUpload( selectedPrinter_, enteredModelName_, selectedModelGroup_, deleteFileCheckbox_->GetValue() );
-        }
+                } );
+    }
+
+    void UploadFrame::OnUploadProgress( gcu::repetier::UploadProgress const& progress )
+    {
+        double const megabyte = 1024.0 * 1024.0;
+        infoLabel_->SetLabel( wxString::Format(
+                _( "Uploaded %.1f of %.1f MB at %.2f MB/s, %lld s left" ),
+                progress.sent / megabyte, progress.total / megabyte, progress.rate / megabyte,
+                (long long) progress.eta.count() ) );
     }
 
     void UploadFrame::OnToolBarExplore()
@@ -155,6 +185,12 @@ namespace gct {
         Close();
     }
 
+    // the connection is still there, so the frame stays open for another try
+    void UploadFrame::OnRequestFailed( std::error_code ec )
+    {
+        wxMessageBox( ec.message(), "Error", wxOK | wxICON_ERROR, this );
+    }
+
     void UploadFrame::OnPrintersChanged( std::vector< gcu::repetier::Printer >&& printers )
     {
         printerChoice_->Clear();
@@ -207,4 +243,27 @@ namespace gct {
         }
     }
 
+    void UploadFrame::OnModelsDiffed( std::string const& printer, gcu::repetier::ModelDiff&& diff )
+    {
+        if ( printer == selectedPrinter_ ) {
+            auto removed = [&diff]( auto const& model ) {
+                return std::find( diff.removed.begin(), diff.removed.end(), model.id() ) != diff.removed.end();
+            };
+            models_.erase( std::remove_if( models_.begin(), models_.end(), removed ), models_.end() );
+            for ( auto&& model : diff.changed ) {
+                auto it = std::find_if( models_.begin(), models_.end(), [&model]( auto const& item ) {
+                    return item.id() == model.id();
+                } );
+                if ( it != models_.end() ) {
+                    *it = std::move( model );
+                }
+                else {
+                    models_.push_back( std::move( model ) );
+                }
+            }
+            std::move( diff.added.begin(), diff.added.end(), std::back_inserter( models_ ) );
+            CheckModelNameExists();
+        }
+    }
+
 } // namespace gct
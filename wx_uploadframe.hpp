@@ -8,6 +8,8 @@
 
 #include "std/filesystem.hpp"
 
+#include "cancellation.hpp"
+#include "future.hpp"
 #include "repetier_definitions.hpp"
 #include "wx_generated.h"
 
@@ -31,9 +33,7 @@ namespace gct {
     private:
         void CheckModelNameExists();
         std::size_t FindSelectedModelId();
-        void PerformUpload(
-                wxString const& printer, wxString const& modelName, wxString const& modelGroup,
-                bool deleteFile );
+        gcu::Future<> PerformUpload( wxString const& printer, wxString const& modelName, wxString const& modelGroup );
 
         void OnPrinterSelected();
         void OnModelGroupSelected();
@@ -43,9 +43,12 @@ namespace gct {
         void OnToolBarExplore();
 
         void OnConnectionLost( std::error_code ec );
+        void OnRequestFailed( std::error_code ec );
         void OnPrintersChanged( std::vector< gcu::repetier::Printer >&& printers );
         void OnModelGroupsChanged( std::string const& printer, std::vector< gcu::repetier::ModelGroup >&& modelGroups );
         void OnModelsChanged( std::string const& printer, std::vector< gcu::repetier::Model >&& models );
+        void OnModelsDiffed( std::string const& printer, gcu::repetier::ModelDiff&& diff );
+        void OnUploadProgress( gcu::repetier::UploadProgress const& progress );
 
         std::shared_ptr< gcu::PrinterService > printerService_;
         std::filesystem::path gcodePath_;
@@ -53,6 +56,7 @@ namespace gct {
         wxString selectedModelGroup_;
         wxString enteredModelName_;
         std::vector< gcu::repetier::Model > models_;
+        gcu::CancellationToken requests_;
     };
 
 } // namespace gct